@@ -34,6 +34,7 @@
 #include <mate-panel-applet.h>
 
 #include "gvc-applet.h"
+#include "gvc-trace.h"
 
 static gboolean
 applet_main (MatePanelApplet* applet_widget)
@@ -61,6 +62,8 @@ applet_main (MatePanelApplet* applet_widget)
         gtk_icon_theme_append_search_path (gtk_icon_theme_get_default (),
                                            ICON_DATA_DIR);
 
+        gvc_trace_init ();
+
         applet = gvc_applet_new ();
 
         gvc_applet_fill (applet, applet_widget);
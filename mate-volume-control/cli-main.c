@@ -0,0 +1,1020 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/* A command line front end to libmatemixer, it does not use GTK so that
+ * it starts fast enough to be run on every key press */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib-object.h>
+
+#include <libintl.h>
+#include <libmatemixer/matemixer.h>
+
+#include "gvc-mixer-state.h"
+
+#define CLI_DBUS_NAME           "org.mate.VolumeControlCli"
+
+/* How long to wait for the sound system */
+#define CONNECT_TIMEOUT_MS      5000
+
+/* How long to wait for the sound system to confirm the changes */
+#define FLUSH_TIMEOUT_MS        1000
+
+/* How long the streams of a device are given to appear after a snapshot
+ * selected a different profile */
+#define RESTORE_SETTLE_MS       500
+
+/* The largest number of volume changes measured by measure-latency */
+#define LATENCY_MAX_SAMPLES     10000
+
+static gboolean    show_version = FALSE;
+static gchar      *backend = NULL;
+static gchar     **commands = NULL;
+
+static GMainLoop  *loop = NULL;
+static GSList     *expectations = NULL;
+
+typedef gboolean (*CommandFunc) (MateMixerContext *context, gchar **args);
+
+typedef struct {
+        const gchar *name;
+        guint        n_args;
+        const gchar *usage;
+        CommandFunc  func;
+} Command;
+
+static void
+print_error (const gchar *format, ...) G_GNUC_PRINTF (1, 2);
+static gboolean
+run_loop (guint timeout_ms);
+
+static void
+print_error (const gchar *format, ...)
+{
+        va_list  args;
+        gchar   *message;
+
+        va_start (args, format);
+        message = g_strdup_vprintf (format, args);
+        va_end (args);
+
+        g_printerr ("%s: %s\n", g_get_prgname (), message);
+        g_free (message);
+}
+
+typedef struct {
+        GObject    *object;
+        GParamSpec *pspec;
+        gulong      handler_id;
+        GValue      before;
+} Expectation;
+
+static void
+expectation_free (Expectation *expectation)
+{
+        g_signal_handler_disconnect (expectation->object, expectation->handler_id);
+
+        if (G_IS_VALUE (&expectation->before))
+                g_value_unset (&expectation->before);
+
+        g_object_unref (expectation->object);
+        g_free (expectation);
+}
+
+/* Whether the property still has the value it had when the change was
+ * requested, only known for the changes that may end up as no change */
+static gboolean
+expectation_is_unchanged (Expectation *expectation)
+{
+        GValue   value = G_VALUE_INIT;
+        gboolean unchanged;
+
+        if (G_IS_VALUE (&expectation->before) == FALSE)
+                return FALSE;
+
+        g_value_init (&value, expectation->pspec->value_type);
+        g_object_get_property (expectation->object,
+                               expectation->pspec->name,
+                               &value);
+
+        unchanged = g_param_values_cmp (expectation->pspec,
+                                        &value,
+                                        &expectation->before) == 0;
+        g_value_unset (&value);
+
+        return unchanged;
+}
+
+static void
+on_change_confirmed (GObject *object, GParamSpec *pspec, Expectation *expectation)
+{
+        expectations = g_slist_remove (expectations, expectation);
+        expectation_free (expectation);
+
+        if (expectations == NULL)
+                g_main_loop_quit (loop);
+}
+
+/* Waits for the property to change before exiting, the sound system
+ * could otherwise drop the request.
+ *
+ * The sound system rounds a volume to the steps of the hardware and does not
+ * notify about a change that was rounded back to the current value, with
+ * may_round set such a change counts as confirmed if the property keeps the
+ * value it has now */
+static void
+expect_change (gpointer object, const gchar *property, gboolean may_round)
+{
+        Expectation *expectation;
+        gchar       *signal;
+
+        expectation = g_new0 (Expectation, 1);
+        expectation->object = g_object_ref (G_OBJECT (object));
+        expectation->pspec  = g_object_class_find_property (G_OBJECT_GET_CLASS (object),
+                                                            property);
+
+        if (may_round == TRUE) {
+                g_value_init (&expectation->before, expectation->pspec->value_type);
+                g_object_get_property (expectation->object,
+                                       property,
+                                       &expectation->before);
+        }
+
+        signal = g_strdup_printf ("notify::%s", property);
+        expectation->handler_id = g_signal_connect (expectation->object,
+                                                    signal,
+                                                    G_CALLBACK (on_change_confirmed),
+                                                    expectation);
+        g_free (signal);
+
+        expectations = g_slist_prepend (expectations, expectation);
+}
+
+/* Waits for the sound system to confirm the requested changes */
+static gboolean
+flush_changes (void)
+{
+        GSList *list;
+
+        if (expectations == NULL || run_loop (FLUSH_TIMEOUT_MS) == TRUE)
+                return TRUE;
+
+        for (list = expectations; list != NULL; list = list->next)
+                if (expectation_is_unchanged (list->data) == FALSE)
+                        return FALSE;
+
+        /* Only changes that did not change anything are left */
+        g_slist_free_full (expectations, (GDestroyNotify) expectation_free);
+        expectations = NULL;
+
+        return TRUE;
+}
+
+/* Accepts "output", "input" or the name of a stream */
+static MateMixerStream *
+find_stream (MateMixerContext *context, const gchar *name)
+{
+        MateMixerStream *stream;
+
+        if (strcmp (name, "output") == 0)
+                stream = mate_mixer_context_get_default_output_stream (context);
+        else if (strcmp (name, "input") == 0)
+                stream = mate_mixer_context_get_default_input_stream (context);
+        else
+                stream = mate_mixer_context_get_stream (context, name);
+
+        if (stream == NULL)
+                print_error (_("No such stream: %s"), name);
+
+        return stream;
+}
+
+static MateMixerStreamControl *
+find_control (MateMixerContext *context, const gchar *name)
+{
+        MateMixerStream        *stream;
+        MateMixerStreamControl *control;
+
+        stream = find_stream (context, name);
+        if (stream == NULL)
+                return NULL;
+
+        control = mate_mixer_stream_get_default_control (stream);
+        if (control == NULL)
+                print_error (_("Stream %s has no volume control"), name);
+
+        return control;
+}
+
+/* The control only reflects a change once the sound system confirms it, so
+ * the values requested by the previous commands are kept with the control and
+ * the following commands build on them instead of the stale state */
+#define PENDING_VOLUME_KEY      "cli-pending-volume"
+#define PENDING_MUTE_KEY        "cli-pending-mute"
+
+static guint
+get_target_volume (MateMixerStreamControl *control)
+{
+        gpointer data = g_object_get_data (G_OBJECT (control), PENDING_VOLUME_KEY);
+
+        if (data != NULL)
+                return GPOINTER_TO_UINT (data) - 1;
+
+        return mate_mixer_stream_control_get_volume (control);
+}
+
+static gboolean
+get_target_mute (MateMixerStreamControl *control)
+{
+        gpointer data = g_object_get_data (G_OBJECT (control), PENDING_MUTE_KEY);
+
+        if (data != NULL)
+                return GPOINTER_TO_INT (data) - 1;
+
+        return mate_mixer_stream_control_get_mute (control);
+}
+
+static gboolean
+request_volume (MateMixerStreamControl *control, guint volume)
+{
+        if (mate_mixer_stream_control_set_volume (control, volume) == FALSE)
+                return FALSE;
+
+        g_object_set_data (G_OBJECT (control),
+                           PENDING_VOLUME_KEY,
+                           GUINT_TO_POINTER (volume + 1));
+
+        expect_change (control, "volume", TRUE);
+        return TRUE;
+}
+
+static gboolean
+request_mute (MateMixerStreamControl *control, gboolean mute)
+{
+        if (mate_mixer_stream_control_set_mute (control, mute) == FALSE)
+                return FALSE;
+
+        g_object_set_data (G_OBJECT (control),
+                           PENDING_MUTE_KEY,
+                           GINT_TO_POINTER (mute + 1));
+
+        expect_change (control, "mute", TRUE);
+        return TRUE;
+}
+
+static guint
+volume_to_percent (MateMixerStreamControl *control, guint volume)
+{
+        guint normal = mate_mixer_stream_control_get_normal_volume (control);
+
+        if (normal == 0)
+                return 0;
+
+        return (guint) (((guint64) volume * 100 + normal / 2) / normal);
+}
+
+static gboolean
+cmd_get_volume (MateMixerContext *context, gchar **args)
+{
+        MateMixerStreamControl *control;
+
+        control = find_control (context, args[0]);
+        if (control == NULL)
+                return FALSE;
+
+        g_print ("%u\n", volume_to_percent (control, get_target_volume (control)));
+        return TRUE;
+}
+
+/* Accepts an absolute percentage, or a change of it prefixed by + or - */
+static gboolean
+cmd_set_volume (MateMixerContext *context, gchar **args)
+{
+        MateMixerStreamControl *control;
+        const gchar            *value = args[1];
+        gchar                  *end;
+        gint64                  percent;
+        gint64                  volume;
+        guint                   normal;
+
+        control = find_control (context, args[0]);
+        if (control == NULL)
+                return FALSE;
+
+        if (!(mate_mixer_stream_control_get_flags (control) & MATE_MIXER_STREAM_CONTROL_VOLUME_WRITABLE)) {
+                print_error (_("The volume of %s cannot be changed"), args[0]);
+                return FALSE;
+        }
+
+        percent = g_ascii_strtoll (value, &end, 10);
+        if (end == value || (*end != '\0' && strcmp (end, "%") != 0)) {
+                print_error (_("Invalid volume: %s"), value);
+                return FALSE;
+        }
+
+        normal = mate_mixer_stream_control_get_normal_volume (control);
+        volume = percent * normal / 100;
+
+        if (value[0] == '+' || value[0] == '-')
+                volume += get_target_volume (control);
+
+        volume = CLAMP (volume,
+                        (gint64) mate_mixer_stream_control_get_min_volume (control),
+                        (gint64) mate_mixer_stream_control_get_max_volume (control));
+
+        if ((guint) volume == get_target_volume (control))
+                return TRUE;
+
+        if (request_volume (control, (guint) volume) == FALSE) {
+                print_error (_("Failed to change the volume of %s"), args[0]);
+                return FALSE;
+        }
+        return TRUE;
+}
+
+static gboolean
+cmd_get_mute (MateMixerContext *context, gchar **args)
+{
+        MateMixerStreamControl *control;
+
+        control = find_control (context, args[0]);
+        if (control == NULL)
+                return FALSE;
+
+        g_print ("%s\n", get_target_mute (control) ? "on" : "off");
+        return TRUE;
+}
+
+static gboolean
+cmd_set_mute (MateMixerContext *context, gchar **args)
+{
+        MateMixerStreamControl *control;
+        gboolean                mute;
+
+        control = find_control (context, args[0]);
+        if (control == NULL)
+                return FALSE;
+
+        if (!(mate_mixer_stream_control_get_flags (control) & MATE_MIXER_STREAM_CONTROL_MUTE_WRITABLE)) {
+                print_error (_("%s cannot be muted"), args[0]);
+                return FALSE;
+        }
+
+        if (strcmp (args[1], "on") == 0)
+                mute = TRUE;
+        else if (strcmp (args[1], "off") == 0)
+                mute = FALSE;
+        else if (strcmp (args[1], "toggle") == 0)
+                mute = !get_target_mute (control);
+        else {
+                print_error (_("Invalid mute state: %s"), args[1]);
+                return FALSE;
+        }
+
+        if (mute == get_target_mute (control))
+                return TRUE;
+
+        if (request_mute (control, mute) == FALSE) {
+                print_error (_("Failed to change the mute state of %s"), args[0]);
+                return FALSE;
+        }
+        return TRUE;
+}
+
+static gboolean
+cmd_list_streams (MateMixerContext *context, gchar **args)
+{
+        const GList     *list;
+        MateMixerStream *output;
+        MateMixerStream *input;
+
+        output = mate_mixer_context_get_default_output_stream (context);
+        input  = mate_mixer_context_get_default_input_stream (context);
+
+        for (list = mate_mixer_context_list_streams (context); list != NULL; list = list->next) {
+                MateMixerStream *stream = MATE_MIXER_STREAM (list->data);
+                const gchar     *direction;
+
+                if (mate_mixer_stream_get_direction (stream) == MATE_MIXER_DIRECTION_OUTPUT)
+                        direction = "output";
+                else if (mate_mixer_stream_get_direction (stream) == MATE_MIXER_DIRECTION_INPUT)
+                        direction = "input";
+                else
+                        direction = "unknown";
+
+                g_print ("%s%s\t%s\t%s\n",
+                         (stream == output || stream == input) ? "* " : "  ",
+                         mate_mixer_stream_get_name (stream),
+                         direction,
+                         mate_mixer_stream_get_label (stream));
+        }
+        return TRUE;
+}
+
+static gboolean
+set_default_stream (MateMixerContext *context, const gchar *name, MateMixerDirection direction)
+{
+        MateMixerStream *stream;
+        MateMixerStream *current;
+        gboolean         result;
+
+        stream = mate_mixer_context_get_stream (context, name);
+        if (stream == NULL || mate_mixer_stream_get_direction (stream) != direction) {
+                print_error (_("No such stream: %s"), name);
+                return FALSE;
+        }
+
+        if (direction == MATE_MIXER_DIRECTION_OUTPUT)
+                current = mate_mixer_context_get_default_output_stream (context);
+        else
+                current = mate_mixer_context_get_default_input_stream (context);
+
+        if (stream == current)
+                return TRUE;
+
+        if (direction == MATE_MIXER_DIRECTION_OUTPUT)
+                result = mate_mixer_context_set_default_output_stream (context, stream);
+        else
+                result = mate_mixer_context_set_default_input_stream (context, stream);
+
+        if (result == FALSE) {
+                print_error (_("Failed to make %s the default stream"), name);
+                return FALSE;
+        }
+
+        expect_change (context,
+                       (direction == MATE_MIXER_DIRECTION_OUTPUT)
+                       ? "default-output-stream"
+                       : "default-input-stream",
+                       FALSE);
+        return TRUE;
+}
+
+static gboolean
+cmd_set_default_output (MateMixerContext *context, gchar **args)
+{
+        return set_default_stream (context, args[0], MATE_MIXER_DIRECTION_OUTPUT);
+}
+
+static gboolean
+cmd_set_default_input (MateMixerContext *context, gchar **args)
+{
+        return set_default_stream (context, args[0], MATE_MIXER_DIRECTION_INPUT);
+}
+
+static gboolean
+cmd_list_devices (MateMixerContext *context, gchar **args)
+{
+        const GList *list;
+
+        for (list = mate_mixer_context_list_devices (context); list != NULL; list = list->next) {
+                MateMixerDevice *device = MATE_MIXER_DEVICE (list->data);
+                const GList     *switches;
+
+                g_print ("%s\t%s\n",
+                         mate_mixer_device_get_name (device),
+                         mate_mixer_device_get_label (device));
+
+                for (switches = mate_mixer_device_list_switches (device); switches != NULL; switches = switches->next) {
+                        MateMixerSwitch       *swtch = MATE_MIXER_SWITCH (switches->data);
+                        MateMixerSwitchOption *active;
+                        const GList           *options;
+
+                        g_print ("  %s\n", mate_mixer_switch_get_name (swtch));
+
+                        active = mate_mixer_switch_get_active_option (swtch);
+
+                        for (options = mate_mixer_switch_list_options (swtch); options != NULL; options = options->next) {
+                                MateMixerSwitchOption *option = MATE_MIXER_SWITCH_OPTION (options->data);
+
+                                g_print ("  %s %s\t%s\n",
+                                         (option == active) ? "*" : " ",
+                                         mate_mixer_switch_option_get_name (option),
+                                         mate_mixer_switch_option_get_label (option));
+                        }
+                }
+        }
+        return TRUE;
+}
+
+/* Selects an option of a device switch, such as the profile */
+static gboolean
+cmd_set_switch (MateMixerContext *context, gchar **args)
+{
+        MateMixerDevice       *device;
+        MateMixerSwitch       *swtch;
+        MateMixerSwitchOption *option;
+
+        device = mate_mixer_context_get_device (context, args[0]);
+        if (device == NULL) {
+                print_error (_("No such device: %s"), args[0]);
+                return FALSE;
+        }
+
+        swtch = mate_mixer_device_get_switch (device, args[1]);
+        if (swtch == NULL) {
+                print_error (_("No such switch: %s"), args[1]);
+                return FALSE;
+        }
+
+        option = mate_mixer_switch_get_option (swtch, args[2]);
+        if (option == NULL) {
+                print_error (_("No such option: %s"), args[2]);
+                return FALSE;
+        }
+
+        if (option == mate_mixer_switch_get_active_option (swtch))
+                return TRUE;
+
+        if (mate_mixer_switch_set_active_option (swtch, option) == FALSE) {
+                print_error (_("Failed to select %s"), args[2]);
+                return FALSE;
+        }
+
+        expect_change (swtch, "active-option", FALSE);
+        return TRUE;
+}
+
+typedef struct {
+        guint    previous;
+        gboolean confirmed;
+} LatencyProbe;
+
+/* Any change away from the previous volume confirms the request, some
+ * backends round the volume to the steps the hardware supports */
+static void
+on_latency_volume_notify (MateMixerStreamControl *control,
+                          GParamSpec             *pspec,
+                          LatencyProbe           *probe)
+{
+        if (probe->confirmed == TRUE ||
+            mate_mixer_stream_control_get_volume (control) == probe->previous)
+                return;
+
+        probe->confirmed = TRUE;
+        g_main_loop_quit (loop);
+}
+
+static gint
+compare_samples (gconstpointer a, gconstpointer b)
+{
+        gint64 sample_a = *(const gint64 *) a;
+        gint64 sample_b = *(const gint64 *) b;
+
+        return (sample_a > sample_b) - (sample_a < sample_b);
+}
+
+/* Measures the time from a volume change until the sound system reports
+ * it back, stepping the volume by one percent and back */
+static gboolean
+cmd_measure_latency (MateMixerContext *context, gchar **args)
+{
+        MateMixerStreamControl *control;
+        LatencyProbe            probe;
+        GArray                 *samples;
+        gulong                  handler_id;
+        gchar                  *end;
+        guint64                 count;
+        guint                   original;
+        guint                   step;
+        guint                   i;
+        gboolean                result = TRUE;
+
+        control = find_control (context, args[0]);
+        if (control == NULL)
+                return FALSE;
+
+        if (!(mate_mixer_stream_control_get_flags (control) & MATE_MIXER_STREAM_CONTROL_VOLUME_WRITABLE)) {
+                print_error (_("The volume of %s cannot be changed"), args[0]);
+                return FALSE;
+        }
+
+        count = g_ascii_strtoull (args[1], &end, 10);
+        if (end == args[1] || *end != '\0' || count == 0 || count > LATENCY_MAX_SAMPLES) {
+                print_error (_("Invalid count: %s"), args[1]);
+                return FALSE;
+        }
+
+        /* Let the changes of the previous commands settle first, a late
+         * confirmation would otherwise end the loop within a sample */
+        if (flush_changes () == FALSE) {
+                print_error (_("The sound system did not confirm the changes"));
+                return FALSE;
+        }
+
+        /* Everything requested so far is now reflected by the control */
+        g_object_set_data (G_OBJECT (control), PENDING_VOLUME_KEY, NULL);
+
+        original = mate_mixer_stream_control_get_volume (control);
+        step = MAX (mate_mixer_stream_control_get_normal_volume (control) / 100, 1);
+
+        samples = g_array_sized_new (FALSE, FALSE, sizeof (gint64), (guint) count);
+
+        handler_id = g_signal_connect (G_OBJECT (control),
+                                       "notify::volume",
+                                       G_CALLBACK (on_latency_volume_notify),
+                                       &probe);
+
+        for (i = 0; i < count; i++) {
+                gint64 start;
+                gint64 elapsed;
+                guint  volume;
+
+                if (i % 2 == 1)
+                        volume = original;
+                else if (original >= mate_mixer_stream_control_get_min_volume (control) + step)
+                        volume = original - step;
+                else
+                        volume = original + step;
+
+                probe.previous = mate_mixer_stream_control_get_volume (control);
+                probe.confirmed = FALSE;
+
+                start = g_get_monotonic_time ();
+
+                if (mate_mixer_stream_control_set_volume (control, volume) == FALSE) {
+                        print_error (_("Failed to change the volume of %s"), args[0]);
+                        result = FALSE;
+                        break;
+                }
+
+                run_loop (FLUSH_TIMEOUT_MS);
+
+                if (probe.confirmed == FALSE) {
+                        print_error (_("The sound system did not confirm the changes"));
+                        result = FALSE;
+                        break;
+                }
+
+                elapsed = g_get_monotonic_time () - start;
+                g_array_append_val (samples, elapsed);
+        }
+
+        g_signal_handler_disconnect (G_OBJECT (control), handler_id);
+
+        if (mate_mixer_stream_control_get_volume (control) != original)
+                request_volume (control, original);
+
+        if (result == TRUE) {
+                gint64 *values;
+
+                g_array_sort (samples, compare_samples);
+                values = (gint64 *) samples->data;
+
+                g_print ("samples %u\n", samples->len);
+                g_print ("p50 %.2f ms\n", values[samples->len / 2] / 1000.0);
+                g_print ("p99 %.2f ms\n", values[MIN (samples->len * 99 / 100, samples->len - 1)] / 1000.0);
+                g_print ("max %.2f ms\n", values[samples->len - 1] / 1000.0);
+        }
+
+        g_array_free (samples, TRUE);
+        return result;
+}
+
+static gboolean
+cmd_save_snapshot (MateMixerContext *context, gchar **args)
+{
+        GError *error = NULL;
+
+        if (gvc_mixer_state_save_snapshot (gvc_mixer_state_capture (context), args[0], &error) == FALSE) {
+                print_error ("%s", error->message);
+                g_error_free (error);
+                return FALSE;
+        }
+        return TRUE;
+}
+
+/* Applies the snapshot until nothing is left to change, selecting a
+ * profile replaces the streams the rest of the snapshot refers to */
+static gboolean
+cmd_restore_snapshot (MateMixerContext *context, gchar **args)
+{
+        GVariant *state;
+        GError   *error = NULL;
+        guint     pass;
+
+        state = gvc_mixer_state_load_snapshot (args[0], &error);
+        if (state == NULL) {
+                print_error ("%s", error->message);
+                g_error_free (error);
+                return FALSE;
+        }
+
+        for (pass = 0; pass < 2; pass++) {
+                guint applied;
+
+                if (gvc_mixer_state_apply (context,
+                                           state,
+                                           GVC_MIXER_STATE_APPLY_SKIP_MISSING,
+                                           &applied,
+                                           &error) == FALSE) {
+                        print_error ("%s", error->message);
+                        g_error_free (error);
+                        g_variant_unref (state);
+                        return FALSE;
+                }
+                if (applied == 0)
+                        break;
+
+                run_loop (RESTORE_SETTLE_MS);
+        }
+
+        g_variant_unref (state);
+        return TRUE;
+}
+
+static gboolean
+cmd_list_snapshots (MateMixerContext *context, gchar **args)
+{
+        gchar **names;
+        guint   i;
+
+        names = gvc_mixer_state_list_snapshots ();
+        for (i = 0; names[i] != NULL; i++)
+                g_print ("%s\n", names[i]);
+
+        g_strfreev (names);
+        return TRUE;
+}
+
+static const Command command_table[] = {
+        { "get-volume",         1, N_("STREAM"),                 cmd_get_volume },
+        { "set-volume",         2, N_("STREAM [+|-]PERCENT"),    cmd_set_volume },
+        { "get-mute",           1, N_("STREAM"),                 cmd_get_mute },
+        { "set-mute",           2, N_("STREAM on|off|toggle"),   cmd_set_mute },
+        { "list-streams",       0, NULL,                         cmd_list_streams },
+        { "set-default-output", 1, N_("STREAM"),                 cmd_set_default_output },
+        { "set-default-input",  1, N_("STREAM"),                 cmd_set_default_input },
+        { "list-devices",       0, NULL,                         cmd_list_devices },
+        { "set-switch",         3, N_("DEVICE SWITCH OPTION"),   cmd_set_switch },
+        { "measure-latency",    2, N_("STREAM COUNT"),           cmd_measure_latency },
+        { "save-snapshot",      1, N_("NAME"),                   cmd_save_snapshot },
+        { "restore-snapshot",   1, N_("NAME"),                   cmd_restore_snapshot },
+        { "list-snapshots",     0, NULL,                         cmd_list_snapshots },
+};
+
+static gboolean
+run_command (MateMixerContext *context, gchar **argv, guint argc)
+{
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (command_table); i++) {
+                const Command *command = &command_table[i];
+
+                if (strcmp (argv[0], command->name) != 0)
+                        continue;
+
+                if (argc - 1 != command->n_args) {
+                        print_error (_("Usage: %s %s"),
+                                     command->name,
+                                     (command->usage != NULL) ? _(command->usage) : "");
+                        return FALSE;
+                }
+                return command->func (context, argv + 1);
+        }
+
+        print_error (_("Unknown command: %s"), argv[0]);
+        return FALSE;
+}
+
+/* Runs the commands of the argument list, separated by ";" */
+static gboolean
+run_argv_commands (MateMixerContext *context, gchar **argv)
+{
+        guint start = 0;
+        guint i;
+
+        for (i = 0; ; i++) {
+                if (argv[i] != NULL && strcmp (argv[i], ";") != 0)
+                        continue;
+
+                if (i > start) {
+                        gchar *saved = argv[i];
+
+                        argv[i] = NULL;
+                        if (run_command (context, argv + start, i - start) == FALSE)
+                                return FALSE;
+                        argv[i] = saved;
+                }
+
+                if (argv[i] == NULL)
+                        break;
+
+                start = i + 1;
+        }
+        return TRUE;
+}
+
+/* Runs one command per line of the standard input */
+static gboolean
+run_stdin_commands (MateMixerContext *context)
+{
+        gchar line[1024];
+
+        while (fgets (line, sizeof (line), stdin) != NULL) {
+                gchar   **argv;
+                gint      argc;
+                gboolean  result;
+                GError   *error = NULL;
+
+                g_strstrip (line);
+                if (line[0] == '\0' || line[0] == '#')
+                        continue;
+
+                if (g_shell_parse_argv (line, &argc, &argv, &error) == FALSE) {
+                        print_error ("%s", error->message);
+                        g_error_free (error);
+                        return FALSE;
+                }
+
+                result = run_command (context, argv, argc);
+                g_strfreev (argv);
+
+                if (result == FALSE)
+                        return FALSE;
+        }
+        return TRUE;
+}
+
+static void
+on_context_state_notify (MateMixerContext *context, GParamSpec *pspec, gpointer data)
+{
+        MateMixerState state = mate_mixer_context_get_state (context);
+
+        if (state != MATE_MIXER_STATE_CONNECTING)
+                g_main_loop_quit (loop);
+}
+
+static gboolean
+on_timeout (gpointer data)
+{
+        gboolean *timed_out = data;
+
+        *timed_out = TRUE;
+        g_main_loop_quit (loop);
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Runs the main loop until it is quit or the timeout expires */
+static gboolean
+run_loop (guint timeout_ms)
+{
+        gboolean timed_out = FALSE;
+        guint    id;
+
+        id = g_timeout_add (timeout_ms, on_timeout, &timed_out);
+        g_main_loop_run (loop);
+
+        if (timed_out == FALSE)
+                g_source_remove (id);
+
+        return !timed_out;
+}
+
+static MateMixerContext *
+open_context (void)
+{
+        MateMixerContext *context;
+
+        context = mate_mixer_context_new ();
+
+        if (backend != NULL) {
+                if (strcmp (backend, "pulse") == 0)
+                        mate_mixer_context_set_backend_type (context, MATE_MIXER_BACKEND_PULSEAUDIO);
+                else if (strcmp (backend, "alsa") == 0)
+                        mate_mixer_context_set_backend_type (context, MATE_MIXER_BACKEND_ALSA);
+                else if (strcmp (backend, "oss") == 0)
+                        mate_mixer_context_set_backend_type (context, MATE_MIXER_BACKEND_OSS);
+                else if (strcmp (backend, "null") == 0)
+                        mate_mixer_context_set_backend_type (context, MATE_MIXER_BACKEND_NULL);
+                else {
+                        print_error (_("Invalid backend: %s"), backend);
+                        g_object_unref (context);
+                        return NULL;
+                }
+        }
+
+        mate_mixer_context_set_app_name (context, _("Volume Control"));
+        mate_mixer_context_set_app_id (context, CLI_DBUS_NAME);
+        mate_mixer_context_set_app_version (context, VERSION);
+        mate_mixer_context_set_app_icon (context, "multimedia-volume-control");
+
+        g_signal_connect (G_OBJECT (context),
+                          "notify::state",
+                          G_CALLBACK (on_context_state_notify),
+                          NULL);
+
+        mate_mixer_context_open (context);
+
+        if (mate_mixer_context_get_state (context) == MATE_MIXER_STATE_CONNECTING)
+                run_loop (CONNECT_TIMEOUT_MS);
+
+        g_signal_handlers_disconnect_by_func (G_OBJECT (context),
+                                              on_context_state_notify,
+                                              NULL);
+
+        if (mate_mixer_context_get_state (context) != MATE_MIXER_STATE_READY) {
+                print_error (_("Sound system is not available"));
+                g_object_unref (context);
+                return NULL;
+        }
+        return context;
+}
+
+int
+main (int argc, char **argv)
+{
+        GError           *error = NULL;
+        GOptionContext   *option_context;
+        MateMixerContext *context;
+        gboolean          result;
+
+        GOptionEntry      entries[] = {
+                { "backend", 'b', 0, G_OPTION_ARG_STRING, &backend, N_("Sound system backend"), "pulse|alsa|oss|null" },
+                { "version", 'v', 0, G_OPTION_ARG_NONE,   &show_version, N_("Version of this application"), NULL },
+                { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &commands, NULL, N_("[COMMAND [ARGUMENTS]] [; COMMAND [ARGUMENTS]]...") },
+                { NULL,        0, 0, G_OPTION_ARG_NONE,   NULL, NULL, NULL }
+        };
+
+        bindtextdomain (GETTEXT_PACKAGE, LOCALE_DIR);
+        bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+        textdomain (GETTEXT_PACKAGE);
+
+        option_context = g_option_context_new (NULL);
+        g_option_context_set_summary (option_context,
+                                      _("Reads or changes the volume, mute state, default streams and "
+                                        "device profiles. Without a command, one command is read from "
+                                        "each line of the standard input."));
+        g_option_context_add_main_entries (option_context, entries, GETTEXT_PACKAGE);
+        g_option_context_set_translation_domain (option_context, GETTEXT_PACKAGE);
+
+        /* Stop at the first command, so that a volume change like -5 is
+         * not taken for an option */
+        g_option_context_set_strict_posix (option_context, TRUE);
+        g_option_context_parse (option_context, &argc, &argv, &error);
+        g_option_context_free (option_context);
+
+        if (error != NULL) {
+                print_error ("%s", error->message);
+                g_error_free (error);
+                return 1;
+        }
+        if (show_version == TRUE) {
+                g_print ("%s %s\n", argv[0], VERSION);
+                return 0;
+        }
+
+        if (mate_mixer_init () == FALSE) {
+                print_error (_("libmatemixer initialization failed"));
+                return 1;
+        }
+
+        loop = g_main_loop_new (NULL, FALSE);
+
+        context = open_context ();
+        if (context == NULL) {
+                g_main_loop_unref (loop);
+                return 1;
+        }
+
+        if (commands != NULL)
+                result = run_argv_commands (context, commands);
+        else
+                result = run_stdin_commands (context);
+
+        if (flush_changes () == FALSE) {
+                print_error (_("The sound system did not confirm the changes"));
+                result = FALSE;
+        }
+
+        g_object_unref (context);
+        g_main_loop_unref (loop);
+        g_strfreev (commands);
+        g_free (backend);
+
+        return result ? 0 : 1;
+}
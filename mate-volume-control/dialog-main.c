@@ -31,22 +31,38 @@
 #include <libmatemixer/matemixer.h>
 
 #include "gvc-mixer-dialog.h"
+#include "gvc-mixer-service.h"
+#include "gvc-trace.h"
+#include "gvc-utils.h"
+#include "sound-theme-file-utils.h"
 
 #define DIALOG_POPUP_TIMEOUT 3
 
 static guint       popup_id = 0;
 static gboolean    debug = FALSE;
 static gboolean    show_version = FALSE;
+static gchar      *export_theme = NULL;
+static gchar      *import_theme = NULL;
+static gboolean    resident = FALSE;
+static gboolean    present_pending = FALSE;
+static gboolean    profile_startup = FALSE;
 
 static gchar      *page = NULL;
 static GtkWidget  *app_dialog = NULL;
 static GtkWidget  *warning_dialog = NULL;
+static GvcMixerService *service = NULL;
 
 static void
 on_dialog_response (GtkDialog *dialog, guint response_id, gpointer data)
 {
         gboolean destroy = GPOINTER_TO_INT (data);
 
+        /* The resident dialog is kept for the next activation */
+        if (resident == TRUE && GTK_WIDGET (dialog) == app_dialog) {
+                gtk_widget_hide (app_dialog);
+                return;
+        }
+
         if (destroy == TRUE)
                 gtk_widget_destroy (GTK_WIDGET (dialog));
 
@@ -58,6 +74,11 @@ on_dialog_close (GtkDialog *dialog, gpointer data)
 {
         gboolean destroy = GPOINTER_TO_INT (data);
 
+        if (resident == TRUE && GTK_WIDGET (dialog) == app_dialog) {
+                gtk_widget_hide (app_dialog);
+                return;
+        }
+
         if (destroy == TRUE)
                 gtk_widget_destroy (GTK_WIDGET (dialog));
 
@@ -76,35 +97,63 @@ remove_warning_dialog (void)
 }
 
 static void
-context_ready (MateMixerContext *context, GtkApplication *application)
+on_app_activate (GApplication *app, gpointer data)
 {
-        /* The dialog might be already created, e.g. when reconnected
-         * to a sound server */
-        GtkApplication *app;
-        GError *error = NULL;
+        /* The service may still be connecting to the sound system, the
+         * dialog is shown once it is built */
+        if (app_dialog != NULL)
+                gtk_window_present (GTK_WINDOW (app_dialog));
+        else
+                present_pending = TRUE;
+}
 
-        app = gtk_application_new ("context.ready", G_APPLICATION_FLAGS_NONE);
-        g_application_register (G_APPLICATION (app), NULL, &error);
-        if (error != NULL)
-        {
-                g_warning ("%s", error->message);
-                g_error_free (error);
-                error = NULL;
-        }
+static void
+on_app_set_page (GSimpleAction *action, GVariant *parameter, gpointer data)
+{
+        g_free (page);
+        page = g_variant_dup_string (parameter, NULL);
 
-        if (g_application_get_is_remote (G_APPLICATION (app)))
-        {
-                g_application_activate (G_APPLICATION (app));
-                g_object_unref (app);
-                app_dialog = GTK_WIDGET (gvc_mixer_dialog_new (context));
-                gtk_main_quit ();
-        }
+        if (app_dialog != NULL)
+                gvc_mixer_dialog_set_page (GVC_MIXER_DIALOG (app_dialog), page);
+}
+
+static gboolean
+on_dialog_first_draw (GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+        g_signal_handlers_disconnect_by_func (G_OBJECT (widget),
+                                              on_dialog_first_draw,
+                                              data);
+
+        gvc_startup_profile_mark ("first frame drawn");
+        return FALSE;
+}
 
+static void
+context_ready (MateMixerContext *context, GApplication *app)
+{
+        GError *error = NULL;
+
+        /* The dialog might be already created, e.g. when reconnected
+         * to a sound server */
         if (app_dialog != NULL)
                 return;
 
+        service = gvc_mixer_service_new (context);
+
+        if (gvc_mixer_service_export (service,
+                                      g_application_get_dbus_connection (app),
+                                      &error) == FALSE) {
+                g_warning ("Failed to export the mixer service: %s", error->message);
+                g_clear_error (&error);
+        }
+
         app_dialog = GTK_WIDGET (gvc_mixer_dialog_new (context));
 
+        g_signal_connect_after (G_OBJECT (app_dialog),
+                                "draw",
+                                G_CALLBACK (on_dialog_first_draw),
+                                NULL);
+
         g_signal_connect (G_OBJECT (app_dialog),
                           "response",
                           G_CALLBACK (on_dialog_response),
@@ -116,19 +165,25 @@ context_ready (MateMixerContext *context, GtkApplication *application)
 
         gvc_mixer_dialog_set_page (GVC_MIXER_DIALOG (app_dialog), page);
 
-        gtk_widget_show (app_dialog);
+        /* The resident dialog is built hidden and waits for an activation */
+        if (resident == FALSE || present_pending == TRUE)
+                gtk_widget_show (app_dialog);
+        else
+                gtk_widget_realize (app_dialog);
 
-        g_signal_connect_swapped (app, "activate", G_CALLBACK (gtk_window_present), app_dialog);
+        present_pending = FALSE;
 }
 
 static void
 on_context_state_notify (MateMixerContext *context,
                          GParamSpec       *pspec,
-                         GtkApplication	  *app)
+                         GApplication     *app)
 {
         MateMixerState state = mate_mixer_context_get_state (context);
 
         if (state == MATE_MIXER_STATE_READY) {
+                gvc_startup_profile_mark ("context ready");
+
                 remove_warning_dialog ();
                 context_ready (context, app);
         }
@@ -156,9 +211,54 @@ on_context_state_notify (MateMixerContext *context,
         }
 }
 
+/* Exports or imports the custom sound theme, this does not need
+ * a display nor the sound system */
+static int
+run_sound_theme_archive (void)
+{
+        GFile    *file;
+        GError   *error = NULL;
+        gboolean  success = FALSE;
+
+        if (export_theme != NULL) {
+                GFileOutputStream *stream;
+
+                file = g_file_new_for_commandline_arg (export_theme);
+                stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error);
+                if (stream != NULL) {
+                        success = custom_theme_export (G_OUTPUT_STREAM (stream), &error) &&
+                                  g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, &error);
+                        g_object_unref (stream);
+                }
+        } else {
+                GFileInputStream *stream;
+
+                file = g_file_new_for_commandline_arg (import_theme);
+                stream = g_file_read (file, NULL, &error);
+                if (stream != NULL) {
+                        success = custom_theme_import (G_INPUT_STREAM (stream), &error);
+                        g_object_unref (stream);
+                }
+        }
+        g_object_unref (file);
+
+        if (success == FALSE) {
+                g_printerr ("%s\n", error->message);
+                g_error_free (error);
+                return 1;
+        }
+        return 0;
+}
+
 static gboolean
 dialog_popup_timeout (gpointer data)
 {
+        popup_id = 0;
+
+        /* Nobody is waiting for the resident dialog yet */
+        if (resident == TRUE && present_pending == FALSE)
+                return FALSE;
+
 	warning_dialog = gtk_message_dialog_new (GTK_WINDOW (app_dialog),
 	                                         0,
 	                                         GTK_MESSAGE_INFO,
@@ -185,40 +285,77 @@ main (int argc, char **argv)
         GError           *error = NULL;
         gchar            *backend = NULL;
         MateMixerContext *context;
-        GApplication	 *app;
+        GApplication     *app;
+        GOptionContext   *option_context;
+        GSimpleAction    *action;
 
         GOptionEntry      entries[] = {
                 { "backend", 'b', 0, G_OPTION_ARG_STRING, &backend, N_("Sound system backend"), "pulse|alsa|oss|null" },
                 { "debug",   'd', 0, G_OPTION_ARG_NONE,   &debug, N_("Enable debug"), NULL },
                 { "page",    'p', 0, G_OPTION_ARG_STRING, &page, N_("Startup page"), "effects|hardware|input|output|applications" },
                 { "version", 'v', 0, G_OPTION_ARG_NONE,   &show_version, N_("Version of this application"), NULL },
+                { "export-sound-theme", 0, 0, G_OPTION_ARG_FILENAME, &export_theme, N_("Export the custom sound theme to an archive and exit"), N_("FILE") },
+                { "import-sound-theme", 0, 0, G_OPTION_ARG_FILENAME, &import_theme, N_("Replace the custom sound theme with an archive and exit"), N_("FILE") },
+                { "service", 0, 0, G_OPTION_ARG_NONE, &resident, N_("Keep running in the background with the dialog ready to be shown"), NULL },
+                { "profile-startup", 0, 0, G_OPTION_ARG_NONE, &profile_startup, N_("Print the time taken by each phase of the startup"), NULL },
                 { NULL,        0, 0, G_OPTION_ARG_NONE,   NULL, NULL, NULL }
         };
 
+        gvc_startup_profile_init ();
+        gvc_trace_init ();
+
         bindtextdomain (GETTEXT_PACKAGE, LOCALE_DIR);
         bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
         textdomain (GETTEXT_PACKAGE);
 
-        gtk_init_with_args (&argc, &argv,
-                            _(" — MATE Volume Control"),
-                            entries, GETTEXT_PACKAGE,
-                            &error);
+        /* The display is only opened once we know it is needed */
+        option_context = g_option_context_new (_(" — MATE Volume Control"));
+        g_option_context_add_main_entries (option_context, entries, GETTEXT_PACKAGE);
+        g_option_context_set_translation_domain (option_context, GETTEXT_PACKAGE);
+        g_option_context_add_group (option_context, gtk_get_option_group (FALSE));
+        g_option_context_parse (option_context, &argc, &argv, &error);
+        g_option_context_free (option_context);
 
         if (error != NULL) {
                 g_warning ("%s", error->message);
                 g_error_free (error);
                 return 1;
         }
+        if (profile_startup == TRUE)
+                gvc_startup_profile_enable ();
+
+        gvc_startup_profile_mark ("options parsed");
+
         if (show_version == TRUE) {
                 g_print ("%s %s\n", argv[0], VERSION);
                 return 0;
         }
+        if (export_theme != NULL || import_theme != NULL)
+                return run_sound_theme_archive ();
+
+        if (gtk_init_check (&argc, &argv) == FALSE) {
+                g_warning ("Unable to open the display");
+                return 1;
+        }
         if (debug == TRUE) {
                 g_setenv ("G_MESSAGES_DEBUG", "all", FALSE);
         }
 
         app = g_application_new (GVC_DIALOG_DBUS_NAME, G_APPLICATION_FLAGS_NONE);
 
+        g_signal_connect (G_OBJECT (app),
+                          "activate",
+                          G_CALLBACK (on_app_activate),
+                          NULL);
+
+        action = g_simple_action_new ("set-page", G_VARIANT_TYPE_STRING);
+        g_signal_connect (G_OBJECT (action),
+                          "activate",
+                          G_CALLBACK (on_app_set_page),
+                          NULL);
+        g_action_map_add_action (G_ACTION_MAP (app), G_ACTION (action));
+        g_object_unref (action);
+
         if (!g_application_register (app, NULL, &error))
         {
                 g_warning ("%s", error->message);
@@ -226,11 +363,30 @@ main (int argc, char **argv)
                 return 1;
         }
 
+        /* Another instance, possibly a resident one, already has its
+         * dialog built, just ask it to present it */
+        if (g_application_get_is_remote (app)) {
+                if (resident == FALSE) {
+                        if (page != NULL)
+                                g_action_group_activate_action (G_ACTION_GROUP (app),
+                                                                "set-page",
+                                                                g_variant_new_string (page));
+
+                        g_application_activate (app);
+                }
+
+                g_dbus_connection_flush_sync (g_application_get_dbus_connection (app), NULL, NULL);
+                g_object_unref (app);
+                return 0;
+        }
+
         if (mate_mixer_init () == FALSE) {
                 g_warning ("libmatemixer initialization failed, exiting");
                 return 1;
         }
 
+        gvc_startup_profile_mark ("mixer initialized");
+
         context = mate_mixer_context_new ();
 
         if (backend != NULL) {
@@ -265,6 +421,11 @@ main (int argc, char **argv)
 
         mate_mixer_context_open (context);
 
+        gvc_startup_profile_mark ("context opened");
+
+        /* The resident dialog is only shown once activated */
+        present_pending = !resident;
+
         if (mate_mixer_context_get_state (context) == MATE_MIXER_STATE_CONNECTING) {
                 popup_id = g_timeout_add_seconds (DIALOG_POPUP_TIMEOUT,
                                                   dialog_popup_timeout,
@@ -278,6 +439,11 @@ main (int argc, char **argv)
 
         gtk_main ();
 
+        if (service != NULL) {
+                gvc_mixer_service_unexport (service);
+                g_object_unref (service);
+        }
+
         g_object_unref (context);
         g_object_unref (app);
 
@@ -34,6 +34,7 @@
 
 #include "gvc-applet.h"
 #include "gvc-stream-applet-icon.h"
+#include "gvc-trace.h"
 
 static const gchar *icon_names_output[] = {
         "audio-volume-muted",
@@ -83,6 +84,7 @@ G_DEFINE_TYPE_WITH_PRIVATE (GvcApplet, gvc_applet, G_TYPE_OBJECT)
 static void
 update_icon_input (GvcApplet *applet)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStreamControl *control = NULL;
         gboolean                show = FALSE;
 
@@ -147,6 +149,7 @@ update_icon_input (GvcApplet *applet)
         }
 
         gvc_stream_applet_icon_set_control (applet->priv->icon_input, control);
+        gvc_trace_watch (control);
 
         gtk_widget_set_visible (GTK_WIDGET (applet->priv->icon_input), show);
 }
@@ -154,6 +157,7 @@ update_icon_input (GvcApplet *applet)
 static void
 update_icon_output (GvcApplet *applet)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStream        *stream;
         MateMixerStreamControl *control = NULL;
 
@@ -162,6 +166,7 @@ update_icon_output (GvcApplet *applet)
                 control = mate_mixer_stream_get_default_control (stream);
 
         gvc_stream_applet_icon_set_control (applet->priv->icon_output, control);
+        gvc_trace_watch (control);
 
         if (control != NULL) {
                 g_debug ("Output icon enabled");
@@ -178,6 +183,7 @@ on_output_stream_control_added (MateMixerStream *stream,
                                 const gchar     *name,
                                 GvcApplet       *applet)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStreamControl *control;
 
         control = mate_mixer_stream_get_control (stream, name);
@@ -200,6 +206,7 @@ on_input_stream_control_added (MateMixerStream *stream,
                                const gchar     *name,
                                GvcApplet       *applet)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStreamControl *control;
 
         control = mate_mixer_stream_get_control (stream, name);
@@ -222,6 +229,8 @@ on_output_stream_control_removed (MateMixerStream *stream,
                                   const gchar     *name,
                                   GvcApplet       *applet)
 {
+        GVC_TRACE_FUNCTION ();
+
         /* The removed stream could be an application output, which may cause
          * the output applet icon to disappear */
         update_icon_output (applet);
@@ -232,6 +241,8 @@ on_input_stream_control_removed (MateMixerStream *stream,
                                  const gchar     *name,
                                  GvcApplet       *applet)
 {
+        GVC_TRACE_FUNCTION ();
+
         /* The removed stream could be an application input, which may cause
          * the input applet icon to disappear */
         update_icon_input (applet);
@@ -304,6 +315,7 @@ on_context_state_notify (MateMixerContext *context,
                          GParamSpec       *pspec,
                          GvcApplet        *applet)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerState state = mate_mixer_context_get_state (context);
 
         switch (state) {
@@ -329,6 +341,8 @@ on_context_default_input_stream_notify (MateMixerContext *context,
                                         GParamSpec       *pspec,
                                         GvcApplet        *applet)
 {
+        GVC_TRACE_FUNCTION ();
+
         if (update_default_input_stream (applet) == FALSE)
                 return;
 
@@ -340,6 +354,8 @@ on_context_default_output_stream_notify (MateMixerContext *control,
                                          GParamSpec       *pspec,
                                          GvcApplet        *applet)
 {
+        GVC_TRACE_FUNCTION ();
+
         if (update_default_output_stream (applet) == FALSE)
                 return;
 
@@ -406,6 +422,7 @@ gvc_applet_init (GvcApplet *applet)
         gvc_stream_applet_icon_set_display_name (applet->priv->icon_output, _("Output"));
 
         applet->priv->context = mate_mixer_context_new ();
+        gvc_trace_watch (applet->priv->context);
 
         mate_mixer_context_set_app_name (applet->priv->context, _("MATE Volume Control Applet"));
 
@@ -29,6 +29,7 @@
 #include <libmatemixer/matemixer.h>
 
 #include "gvc-balance-bar.h"
+#include "gvc-trace.h"
 
 #define SCALE_SIZE 128
 
@@ -214,6 +215,8 @@ on_balance_value_changed (MateMixerStream *stream,
                           GParamSpec      *pspec,
                           GvcBalanceBar   *bar)
 {
+        GVC_TRACE_FUNCTION ();
+
         update_balance_value (bar);
 }
 
@@ -33,9 +33,29 @@
 #include <libmatemixer/matemixer.h>
 
 #include "gvc-channel-bar.h"
+#include "gvc-trace.h"
 
 #define SCALE_SIZE 128
 
+/* Marks of a scale, shared between the bars with the same volume range so
+ * that creating many bars does not format and add them again */
+typedef struct
+{
+        gdouble                     lower;
+        gdouble                     base;
+        gdouble                     normal;
+        gboolean                    extended;
+        gboolean                    show_mark_text;
+} MarkKey;
+
+typedef struct
+{
+        MarkKey                     key;
+        guint                       n_marks;
+        gdouble                     values[2];
+        gchar                      *markup[2];
+} MarkSet;
+
 struct _GvcChannelBarPrivate
 {
         GtkOrientation              orientation;
@@ -59,6 +79,8 @@ struct _GvcChannelBarPrivate
         gboolean                    click_lock;
         MateMixerStreamControl     *control;
         MateMixerStreamControlFlags control_flags;
+        const MarkSet              *marks;
+        gboolean                    marks_applied;
 };
 
 enum {
@@ -89,8 +111,81 @@ static gboolean on_scale_scroll_event         (GtkWidget          *widget,
                                                GdkEventScroll     *event,
                                                GvcChannelBar      *bar);
 
+static void     update_marks                  (GvcChannelBar      *bar);
+
 G_DEFINE_TYPE_WITH_PRIVATE (GvcChannelBar, gvc_channel_bar, GTK_TYPE_BOX)
 
+static guint
+mark_key_hash (gconstpointer data)
+{
+        const MarkKey *key = data;
+
+        return g_double_hash (&key->base) ^
+               (g_double_hash (&key->normal) << 1) ^
+               (g_double_hash (&key->lower) << 2) ^
+               (key->extended << 3) ^
+               (key->show_mark_text << 4);
+}
+
+static gboolean
+mark_key_equal (gconstpointer a, gconstpointer b)
+{
+        const MarkKey *key_a = a;
+        const MarkKey *key_b = b;
+
+        return key_a->lower == key_b->lower &&
+               key_a->base == key_b->base &&
+               key_a->normal == key_b->normal &&
+               key_a->extended == key_b->extended &&
+               key_a->show_mark_text == key_b->show_mark_text;
+}
+
+/* Returns the marks for the key, they are computed once and kept for the
+ * lifetime of the process, there are only a few distinct volume ranges */
+static const MarkSet *
+lookup_mark_set (const MarkKey *key)
+{
+        static GHashTable *mark_sets = NULL;
+        MarkSet           *set;
+
+        if (G_UNLIKELY (mark_sets == NULL))
+                mark_sets = g_hash_table_new (mark_key_hash, mark_key_equal);
+
+        set = g_hash_table_lookup (mark_sets, key);
+        if (set != NULL)
+                return set;
+
+        set = g_new0 (MarkSet, 1);
+        set->key = *key;
+
+        /* Base volume represents unamplified volume, normal volume is the 100%
+         * volume, in many cases they are the same as unamplified volume is unknown */
+        if (key->normal > key->lower) {
+                if (key->base < key->normal) {
+                        if (key->show_mark_text)
+                                set->markup[set->n_marks] =
+                                        g_strdup_printf ("<small>%s</small>",
+                                                         C_("volume", "Unamplified"));
+
+                        set->values[set->n_marks++] = key->base;
+                }
+
+                /* Only show 100% mark if the scale is extended beyond 100% and
+                 * there is no unamplified mark or it is below the normal volume */
+                if (key->extended && key->base <= key->normal) {
+                        if (key->show_mark_text)
+                                set->markup[set->n_marks] =
+                                        g_strdup_printf ("<small>%s</small>",
+                                                         C_("volume", "100%"));
+
+                        set->values[set->n_marks++] = key->normal;
+                }
+        }
+
+        g_hash_table_insert (mark_sets, &set->key, set);
+        return set;
+}
+
 static void
 create_scale_box (GvcChannelBar *bar)
 {
@@ -99,6 +194,10 @@ create_scale_box (GvcChannelBar *bar)
         bar->priv->end_box   = gtk_box_new (bar->priv->orientation, 6);
         bar->priv->scale     = gtk_scale_new (bar->priv->orientation,
                                               bar->priv->adjustment);
+
+        /* The new scale has no marks yet */
+        bar->priv->marks_applied = FALSE;
+
         if (bar->priv->orientation == GTK_ORIENTATION_VERTICAL) {
                 gtk_widget_set_size_request (bar->priv->scale, -1, SCALE_SIZE);
 
@@ -279,6 +378,8 @@ update_layout (GvcChannelBar *bar)
         create_scale_box (bar);
         gtk_container_add (GTK_CONTAINER (frame), bar->priv->scale_box);
 
+        update_marks (bar);
+
         g_object_unref (bar->priv->image);
         g_object_unref (bar->priv->label);
         g_object_unref (bar->priv->mute_button);
@@ -313,56 +414,39 @@ update_scale_size (GvcChannelBar *bar)
 static void
 update_marks (GvcChannelBar *bar)
 {
-        gdouble  base;
-        gdouble  normal;
-        gboolean has_mark = FALSE;
+        const MarkSet *marks = NULL;
+        guint          i;
 
-        gtk_scale_clear_marks (GTK_SCALE (bar->priv->scale));
+        if (bar->priv->control != NULL && bar->priv->show_marks != FALSE) {
+                MarkKey key;
 
-        if (bar->priv->control == NULL || bar->priv->show_marks == FALSE)
-                return;
+                key.lower          = gtk_adjustment_get_lower (bar->priv->adjustment);
+                key.base           = mate_mixer_stream_control_get_base_volume (bar->priv->control);
+                key.normal         = mate_mixer_stream_control_get_normal_volume (bar->priv->control);
+                key.extended       = bar->priv->extended;
+                key.show_mark_text = bar->priv->show_mark_text;
 
-        /* Base volume represents unamplified volume, normal volume is the 100%
-         * volume, in many cases they are the same as unamplified volume is unknown */
-        base   = mate_mixer_stream_control_get_base_volume (bar->priv->control);
-        normal = mate_mixer_stream_control_get_normal_volume (bar->priv->control);
+                marks = lookup_mark_set (&key);
+        }
 
-        if (normal <= gtk_adjustment_get_lower (bar->priv->adjustment))
+        /* Changing the marks makes the scale measure itself and its text
+         * again, avoid it when nothing changes */
+        if (bar->priv->marks_applied != FALSE && marks == bar->priv->marks)
                 return;
 
-        if (base < normal) {
-                gchar *str = NULL;
+        gtk_scale_clear_marks (GTK_SCALE (bar->priv->scale));
 
-                if (bar->priv->show_mark_text)
-                        str = g_strdup_printf ("<small>%s</small>",
-                                               C_("volume", "Unamplified"));
+        if (marks != NULL)
+                for (i = 0; i < marks->n_marks; i++)
+                        gtk_scale_add_mark (GTK_SCALE (bar->priv->scale),
+                                            marks->values[i],
+                                            GTK_POS_BOTTOM,
+                                            marks->markup[i]);
 
-                gtk_scale_add_mark (GTK_SCALE (bar->priv->scale),
-                                    base,
-                                    GTK_POS_BOTTOM,
-                                    str);
-                has_mark = TRUE;
-                g_free (str);
-        }
+        bar->priv->marks         = marks;
+        bar->priv->marks_applied = TRUE;
 
-        /* Only show 100% mark if the scale is extended beyond 100% and
-         * there is no unamplified mark or it is below the normal volume */
-        if (bar->priv->extended && (base == normal || base < normal)) {
-                gchar *str = NULL;
-
-                if (bar->priv->show_mark_text)
-                        str = g_strdup_printf ("<small>%s</small>",
-                                               C_("volume", "100%"));
-
-                gtk_scale_add_mark (GTK_SCALE (bar->priv->scale),
-                                    normal,
-                                    GTK_POS_BOTTOM,
-                                    str);
-                has_mark = TRUE;
-                g_free (str);
-        }
-
-        if (has_mark) {
+        if (marks != NULL && marks->n_marks > 0) {
                 gtk_widget_set_valign (bar->priv->mute_button, GTK_ALIGN_START);
 
                 gtk_widget_set_halign (bar->priv->low_image, GTK_ALIGN_CENTER);
@@ -534,6 +618,8 @@ on_control_volume_notify (MateMixerStreamControl *control,
                           GParamSpec             *pspec,
                           GvcChannelBar          *bar)
 {
+        GVC_TRACE_FUNCTION ();
+
         update_adjustment_value (bar);
 }
 
@@ -542,6 +628,8 @@ on_control_mute_notify (MateMixerStreamControl *control,
                         GParamSpec             *pspec,
                         GvcChannelBar          *bar)
 {
+        GVC_TRACE_FUNCTION ();
+
         if (bar->priv->show_mute == TRUE) {
                 gboolean mute = mate_mixer_stream_control_get_mute (control);
 
@@ -795,38 +883,120 @@ gvc_channel_bar_get_icon_name (GvcChannelBar *bar)
         return name;
 }
 
+/* The number of icons kept, the cache lives in the resident applet as well
+ * so only the recently used icons are kept */
+#define ICON_CACHE_SIZE 32
+
+typedef struct
+{
+        GHashTable *icons;
+        GQueue      keys;
+} IconCache;
+
+static void
+free_icon_pixbuf (gpointer pixbuf)
+{
+        if (pixbuf != NULL)
+                g_object_unref (pixbuf);
+}
+
+static void
+on_icon_theme_changed (GtkIconTheme *icon_theme, IconCache *cache)
+{
+        g_queue_clear (&cache->keys);
+        g_hash_table_remove_all (cache->icons);
+}
+
+/* Loads the application icon, the icons are kept in a small process-wide
+ * cache so that the many bars of the same application or of applications
+ * without an icon do not go through the icon theme or the disk each time.
+ *
+ * Failed lookups are remembered as well, the least recently used entries
+ * are dropped once the cache is full and all of them when the icon theme
+ * changes. */
+static GdkPixbuf *
+load_icon_pixbuf (const gchar *name, gint width, gint height)
+{
+        static IconCache *cache = NULL;
+        GtkIconTheme     *icon_theme;
+        GdkPixbuf        *pixbuf;
+        GError           *error = NULL;
+        gchar            *key;
+        gpointer          stored_key;
+        gpointer          value;
+
+        icon_theme = gtk_icon_theme_get_default ();
+
+        if (G_UNLIKELY (cache == NULL)) {
+                cache = g_new0 (IconCache, 1);
+                cache->icons = g_hash_table_new_full (g_str_hash,
+                                                      g_str_equal,
+                                                      g_free,
+                                                      free_icon_pixbuf);
+                g_queue_init (&cache->keys);
+
+                /* The default icon theme lives as long as the screen */
+                g_signal_connect (G_OBJECT (icon_theme),
+                                  "changed",
+                                  G_CALLBACK (on_icon_theme_changed),
+                                  cache);
+        }
+
+        key = g_strdup_printf ("%s@%dx%d", name, width, height);
+
+        if (g_hash_table_lookup_extended (cache->icons, key, &stored_key, &value) == TRUE) {
+                g_free (key);
+
+                /* Move the entry to the front */
+                g_queue_remove (&cache->keys, stored_key);
+                g_queue_push_head (&cache->keys, stored_key);
+
+                return (value != NULL) ? g_object_ref (value) : NULL;
+        }
+
+        pixbuf = gtk_icon_theme_load_icon (icon_theme,
+                                           name,
+                                           width,
+                                           GTK_ICON_LOOKUP_GENERIC_FALLBACK | GTK_ICON_LOOKUP_FORCE_SIZE,
+                                           &error);
+        if (error != NULL) {
+                g_warning ("Couldn’t load icon: %s\n", error->message);
+                g_clear_error (&error);
+        }
+
+        if (pixbuf == NULL) {
+                pixbuf = gdk_pixbuf_new_from_file_at_scale (name, width, height, TRUE, &error);
+                if (error != NULL)
+                {
+                        g_warning ("Couldn’t load icon: %s\n", error->message);
+                        g_clear_error (&error);
+                }
+        }
+
+        /* The queue does not own the keys, the table does */
+        if (g_queue_get_length (&cache->keys) >= ICON_CACHE_SIZE)
+                g_hash_table_remove (cache->icons, g_queue_pop_tail (&cache->keys));
+
+        g_hash_table_insert (cache->icons,
+                             key,
+                             (pixbuf != NULL) ? g_object_ref (pixbuf) : NULL);
+        g_queue_push_head (&cache->keys, key);
+
+        return pixbuf;
+}
+
 void
 gvc_channel_bar_set_icon_name (GvcChannelBar *bar, const gchar *name)
 {
         g_return_if_fail (GVC_IS_CHANNEL_BAR (bar));
 
         if (name != NULL) {
-                GtkIconTheme *icon_theme;
                 GdkPixbuf *pixbuf;
                 gint width, height;
-                GError *error = NULL;
 
                 gtk_icon_size_lookup (GTK_ICON_SIZE_DIALOG, &width, &height);
-                icon_theme = gtk_icon_theme_get_default ();
-                pixbuf = gtk_icon_theme_load_icon (icon_theme,
-                                                   name,
-                                                   width,
-                                                   GTK_ICON_LOOKUP_GENERIC_FALLBACK | GTK_ICON_LOOKUP_FORCE_SIZE,
-                                                   &error);
-                if (error != NULL) {
-                        g_warning ("Couldn’t load icon: %s\n", error->message);
-                        g_clear_error (&error);
-                }
-
-                if (pixbuf == NULL) {
-                        pixbuf = gdk_pixbuf_new_from_file_at_scale (name, width, height, TRUE, &error);
-                        if (error != NULL)
-                        {
-                                g_warning ("Couldn’t load icon: %s\n", error->message);
-                                g_clear_error (&error);
-                        }
-                }
 
+                pixbuf = load_icon_pixbuf (name, width, height);
                 if (pixbuf) {
                         gtk_image_set_from_pixbuf (GTK_IMAGE (bar->priv->image), pixbuf);
                         gtk_widget_show (bar->priv->image);
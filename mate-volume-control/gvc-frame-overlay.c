@@ -0,0 +1,403 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include <libmatemixer/matemixer.h>
+
+#include "gvc-frame-overlay.h"
+
+/* Environment variable which turns on the overlay */
+#define OVERLAY_ENV             "MATE_VOLUME_CONTROL_FRAME_OVERLAY"
+
+/* How often the overlay text is refreshed */
+#define OVERLAY_INTERVAL        1
+
+#define OVERLAY_KEY             "gvc-frame-overlay"
+#define OVERLAY_MARGIN          4
+
+/* Widgets whose draws are counted, by type name so that the code does not
+ * depend on the widgets linked into each program */
+static const gchar *counted_types[] = {
+        "GvcLevelBar",
+        "GvcChannelBar",
+        "GvcBalanceBar"
+};
+
+typedef struct {
+        guint draws;
+        guint unchanged;
+} DrawCount;
+
+typedef struct {
+        GtkWidget     *window;
+        GdkFrameClock *clock;
+        gulong         clock_handlers[4];
+        guint          timeout_id;
+
+        /* Phases of the current frame */
+        gint64         frame_start;
+        gint64         layout_end;
+        gint64         paint_end;
+
+        /* Totals of the current interval */
+        guint          frames;
+        gint64         layout_total;
+        gint64         layout_max;
+        gint64         paint_total;
+        gint64         paint_max;
+        DrawCount      counts[G_N_ELEMENTS (counted_types)];
+
+        gchar         *text;
+} FrameOverlay;
+
+static GQuark  signature_quark = 0;
+static GSList *overlays = NULL;
+
+/* Mixes what a draw of the widget depends on, two draws with the same
+ * signature look the same */
+static guint
+widget_signature (GtkWidget *widget)
+{
+        GtkAllocation  allocation;
+        GObjectClass  *klass = G_OBJECT_GET_CLASS (widget);
+        const gchar   *adjustments[] = { "peak-adjustment", "rms-adjustment" };
+        gdouble        values[8];
+        guint          n_values = 0;
+        guint          hash;
+        guint          i;
+
+        gtk_widget_get_allocation (widget, &allocation);
+
+        values[n_values++] = allocation.width;
+        values[n_values++] = allocation.height;
+        values[n_values++] = gtk_widget_get_state_flags (widget);
+
+        for (i = 0; i < G_N_ELEMENTS (adjustments); i++) {
+                GtkAdjustment *adjustment = NULL;
+
+                if (g_object_class_find_property (klass, adjustments[i]) == NULL)
+                        continue;
+
+                g_object_get (G_OBJECT (widget), adjustments[i], &adjustment, NULL);
+                if (adjustment != NULL) {
+                        values[n_values++] = gtk_adjustment_get_value (adjustment);
+                        g_object_unref (adjustment);
+                }
+        }
+
+        if (g_object_class_find_property (klass, "control") != NULL) {
+                MateMixerStreamControl *control = NULL;
+
+                g_object_get (G_OBJECT (widget), "control", &control, NULL);
+                if (control != NULL) {
+                        values[n_values++] = mate_mixer_stream_control_get_volume (control);
+                        values[n_values++] = mate_mixer_stream_control_get_mute (control);
+                        values[n_values++] = mate_mixer_stream_control_get_balance (control);
+                        values[n_values++] = mate_mixer_stream_control_get_fade (control);
+                        g_object_unref (control);
+                }
+        }
+
+        /* FNV-1a */
+        hash = 2166136261u;
+        for (i = 0; i < n_values * sizeof (gdouble); i++) {
+                hash ^= ((const guint8 *) values)[i];
+                hash *= 16777619u;
+        }
+
+        /* Zero means no previous draw */
+        return hash | 1;
+}
+
+static gboolean
+on_draw_emission (GSignalInvocationHint *hint,
+                  guint                  n_param_values,
+                  const GValue          *param_values,
+                  gpointer               data)
+{
+        GtkWidget    *widget = g_value_get_object (&param_values[0]);
+        GtkWidget    *toplevel;
+        const gchar  *name;
+        GSList       *list;
+        guint         signature;
+        guint         i;
+
+        name = G_OBJECT_TYPE_NAME (widget);
+
+        for (i = 0; i < G_N_ELEMENTS (counted_types); i++)
+                if (strcmp (name, counted_types[i]) == 0)
+                        break;
+
+        if (i == G_N_ELEMENTS (counted_types))
+                return TRUE;
+
+        toplevel = gtk_widget_get_toplevel (widget);
+
+        for (list = overlays; list != NULL; list = list->next) {
+                FrameOverlay *overlay = list->data;
+
+                if (overlay->window != toplevel)
+                        continue;
+
+                signature = widget_signature (widget);
+
+                overlay->counts[i].draws++;
+                if (GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (widget), signature_quark)) == signature)
+                        overlay->counts[i].unchanged++;
+
+                g_object_set_qdata (G_OBJECT (widget), signature_quark, GUINT_TO_POINTER (signature));
+                break;
+        }
+        return TRUE;
+}
+
+static void
+on_clock_before_paint (GdkFrameClock *clock, FrameOverlay *overlay)
+{
+        overlay->frame_start = g_get_monotonic_time ();
+        overlay->layout_end  = 0;
+        overlay->paint_end   = 0;
+}
+
+/* Connected after the toplevel window, this runs once the layout is done */
+static void
+on_clock_layout (GdkFrameClock *clock, FrameOverlay *overlay)
+{
+        overlay->layout_end = g_get_monotonic_time ();
+}
+
+static void
+on_clock_paint (GdkFrameClock *clock, FrameOverlay *overlay)
+{
+        overlay->paint_end = g_get_monotonic_time ();
+}
+
+static void
+on_clock_after_paint (GdkFrameClock *clock, FrameOverlay *overlay)
+{
+        gint64 layout = 0;
+        gint64 paint;
+
+        if (overlay->frame_start == 0 || overlay->paint_end == 0)
+                return;
+
+        if (overlay->layout_end != 0) {
+                layout = overlay->layout_end - overlay->frame_start;
+                paint  = overlay->paint_end - overlay->layout_end;
+        } else
+                paint  = overlay->paint_end - overlay->frame_start;
+
+        overlay->frames++;
+        overlay->layout_total += layout;
+        overlay->layout_max    = MAX (overlay->layout_max, layout);
+        overlay->paint_total  += paint;
+        overlay->paint_max     = MAX (overlay->paint_max, paint);
+
+        overlay->frame_start = 0;
+}
+
+static gboolean
+on_window_draw (GtkWidget *widget, cairo_t *cr, FrameOverlay *overlay)
+{
+        PangoLayout *layout;
+        gint         width;
+        gint         height;
+
+        if (overlay->text == NULL)
+                return FALSE;
+
+        layout = gtk_widget_create_pango_layout (widget, overlay->text);
+        pango_layout_get_pixel_size (layout, &width, &height);
+
+        cairo_save (cr);
+        cairo_set_source_rgba (cr, 0, 0, 0, 0.7);
+        cairo_rectangle (cr, 0, 0, width + 2 * OVERLAY_MARGIN, height + 2 * OVERLAY_MARGIN);
+        cairo_fill (cr);
+
+        cairo_set_source_rgb (cr, 1, 1, 1);
+        cairo_move_to (cr, OVERLAY_MARGIN, OVERLAY_MARGIN);
+        pango_cairo_show_layout (cr, layout);
+        cairo_restore (cr);
+
+        g_object_unref (layout);
+        return FALSE;
+}
+
+static gboolean
+refresh_overlay (FrameOverlay *overlay)
+{
+        GString *text;
+        guint    i;
+
+        text = g_string_new (NULL);
+
+        g_string_append_printf (text,
+                                "%u frames/s\n"
+                                "layout %.2f ms avg, %.2f ms max\n"
+                                "paint %.2f ms avg, %.2f ms max",
+                                overlay->frames / OVERLAY_INTERVAL,
+                                overlay->frames ? overlay->layout_total / 1000.0 / overlay->frames : 0.0,
+                                overlay->layout_max / 1000.0,
+                                overlay->frames ? overlay->paint_total / 1000.0 / overlay->frames : 0.0,
+                                overlay->paint_max / 1000.0);
+
+        for (i = 0; i < G_N_ELEMENTS (counted_types); i++)
+                g_string_append_printf (text,
+                                        "\n%s %u draws/s, %u unchanged",
+                                        counted_types[i],
+                                        overlay->counts[i].draws / OVERLAY_INTERVAL,
+                                        overlay->counts[i].unchanged / OVERLAY_INTERVAL);
+
+        g_free (overlay->text);
+        overlay->text = g_string_free (text, FALSE);
+
+        overlay->frames       = 0;
+        overlay->layout_total = 0;
+        overlay->layout_max   = 0;
+        overlay->paint_total  = 0;
+        overlay->paint_max    = 0;
+        memset (overlay->counts, 0, sizeof (overlay->counts));
+
+        gtk_widget_queue_draw (overlay->window);
+        return G_SOURCE_CONTINUE;
+}
+
+static void
+disconnect_clock (FrameOverlay *overlay)
+{
+        guint i;
+
+        if (overlay->clock == NULL)
+                return;
+
+        for (i = 0; i < G_N_ELEMENTS (overlay->clock_handlers); i++)
+                g_signal_handler_disconnect (overlay->clock, overlay->clock_handlers[i]);
+
+        g_clear_object (&overlay->clock);
+}
+
+static void
+on_window_realize (GtkWidget *widget, FrameOverlay *overlay)
+{
+        disconnect_clock (overlay);
+
+        overlay->clock = gtk_widget_get_frame_clock (widget);
+        if (overlay->clock == NULL)
+                return;
+
+        g_object_ref (overlay->clock);
+
+        overlay->clock_handlers[0] =
+                g_signal_connect (overlay->clock, "before-paint",
+                                  G_CALLBACK (on_clock_before_paint), overlay);
+        overlay->clock_handlers[1] =
+                g_signal_connect_after (overlay->clock, "layout",
+                                        G_CALLBACK (on_clock_layout), overlay);
+        overlay->clock_handlers[2] =
+                g_signal_connect_after (overlay->clock, "paint",
+                                        G_CALLBACK (on_clock_paint), overlay);
+        overlay->clock_handlers[3] =
+                g_signal_connect (overlay->clock, "after-paint",
+                                  G_CALLBACK (on_clock_after_paint), overlay);
+}
+
+static void
+on_window_unrealize (GtkWidget *widget, FrameOverlay *overlay)
+{
+        disconnect_clock (overlay);
+}
+
+static void
+frame_overlay_free (FrameOverlay *overlay)
+{
+        overlays = g_slist_remove (overlays, overlay);
+
+        disconnect_clock (overlay);
+
+        g_source_remove (overlay->timeout_id);
+        g_free (overlay->text);
+        g_free (overlay);
+}
+
+/**
+ * gvc_frame_overlay_attach:
+ * @window: a toplevel window
+ *
+ * Shows the frame timings of @window and how often the mixer widgets in
+ * it are drawn, in its top left corner. It does nothing unless the
+ * MATE_VOLUME_CONTROL_FRAME_OVERLAY environment variable is set.
+ */
+void
+gvc_frame_overlay_attach (GtkWidget *window)
+{
+        FrameOverlay *overlay;
+
+        g_return_if_fail (GTK_IS_WINDOW (window));
+
+        if (g_getenv (OVERLAY_ENV) == NULL)
+                return;
+        if (g_object_get_data (G_OBJECT (window), OVERLAY_KEY) != NULL)
+                return;
+
+        if (signature_quark == 0) {
+                signature_quark = g_quark_from_static_string ("gvc-frame-overlay-signature");
+
+                g_signal_add_emission_hook (g_signal_lookup ("draw", GTK_TYPE_WIDGET),
+                                            0,
+                                            on_draw_emission,
+                                            NULL,
+                                            NULL);
+        }
+
+        overlay = g_new0 (FrameOverlay, 1);
+        overlay->window = window;
+        overlay->timeout_id = g_timeout_add_seconds (OVERLAY_INTERVAL,
+                                                     (GSourceFunc) refresh_overlay,
+                                                     overlay);
+
+        overlays = g_slist_prepend (overlays, overlay);
+
+        g_object_set_data_full (G_OBJECT (window),
+                                OVERLAY_KEY,
+                                overlay,
+                                (GDestroyNotify) frame_overlay_free);
+
+        g_signal_connect_after (G_OBJECT (window),
+                                "draw",
+                                G_CALLBACK (on_window_draw),
+                                overlay);
+        g_signal_connect (G_OBJECT (window),
+                          "realize",
+                          G_CALLBACK (on_window_realize),
+                          overlay);
+        g_signal_connect (G_OBJECT (window),
+                          "unrealize",
+                          G_CALLBACK (on_window_unrealize),
+                          overlay);
+
+        if (gtk_widget_get_realized (window))
+                on_window_realize (window, overlay);
+}
@@ -38,6 +38,8 @@
 #include "gvc-level-bar.h"
 #include "gvc-speaker-test.h"
 #include "gvc-utils.h"
+#include "gvc-frame-overlay.h"
+#include "gvc-trace.h"
 
 struct _GvcMixerDialogPrivate
 {
@@ -102,6 +104,11 @@ enum {
         PAGE_APPLICATIONS
 };
 
+enum {
+        SPEAKER_TEST_RESPONSE_ALL = 1,
+        SPEAKER_TEST_RESPONSE_LOOPBACK
+};
+
 enum {
         PROP_0,
         PROP_CONTEXT
@@ -463,6 +470,7 @@ on_context_default_output_stream_notify (MateMixerContext *context,
                                          GParamSpec       *pspec,
                                          GvcMixerDialog   *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStream *stream;
 
         stream = mate_mixer_context_get_default_output_stream (context);
@@ -477,6 +485,7 @@ on_stream_control_monitor_value (MateMixerStream *stream,
                                  gdouble          value,
                                  GvcMixerDialog  *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         GtkAdjustment *adj;
 
         if (dialog->priv->last_input_peak >= DECAY_STEP) {
@@ -553,6 +562,8 @@ on_stream_control_mute_notify (MateMixerStreamControl *control,
                                GParamSpec             *pspec,
                                GvcMixerDialog         *dialog)
 {
+        GVC_TRACE_FUNCTION ();
+
         /* Stop monitoring the input stream when it gets muted */
         if (mate_mixer_stream_control_get_mute (control) == TRUE)
                 mate_mixer_stream_control_set_monitor_enabled (control, FALSE);
@@ -639,6 +650,7 @@ on_context_default_input_stream_notify (MateMixerContext *context,
                                         GParamSpec       *pspec,
                                         GvcMixerDialog   *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStream *stream;
 
         g_debug ("Default input stream has changed");
@@ -711,6 +723,7 @@ bar_set_stream_control (GvcMixerDialog         *dialog,
         }
 
         gvc_channel_bar_set_control (GVC_CHANNEL_BAR (bar), control);
+        gvc_trace_watch (control);
 
         if (control != NULL) {
                 name = mate_mixer_stream_control_get_name (control);
@@ -818,6 +831,7 @@ on_stream_control_added (MateMixerStream *stream,
                          const gchar     *name,
                          GvcMixerDialog  *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStreamControl    *control;
         MateMixerStreamControlRole role;
 
@@ -836,6 +850,7 @@ on_stream_control_removed (MateMixerStream *stream,
                            const gchar     *name,
                            GvcMixerDialog  *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStreamControl *control;
 
         control = gvc_channel_bar_get_control (GVC_CHANNEL_BAR (dialog->priv->input_bar));
@@ -873,6 +888,8 @@ add_stream (GvcMixerDialog *dialog, MateMixerStream *stream)
         gboolean           is_default = FALSE;
         MateMixerDirection direction;
 
+        gvc_trace_watch (stream);
+
         direction = mate_mixer_stream_get_direction (stream);
 
         if (direction == MATE_MIXER_DIRECTION_INPUT) {
@@ -970,6 +987,7 @@ on_context_stream_added (MateMixerContext *context,
                          const gchar      *name,
                          GvcMixerDialog   *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStream   *stream;
         MateMixerDirection direction;
         GtkWidget         *bar;
@@ -1076,6 +1094,8 @@ on_context_stream_removed (MateMixerContext *context,
                            const gchar      *name,
                            GvcMixerDialog   *dialog)
 {
+        GVC_TRACE_FUNCTION ();
+
         if (dialog->priv->hw_profile_combo != NULL) {
                 gboolean show_button;
 
@@ -1095,6 +1115,7 @@ on_context_stored_control_added (MateMixerContext *context,
                                  const gchar      *name,
                                  GvcMixerDialog   *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStreamControl         *control;
         MateMixerStreamControlMediaRole media_role;
 
@@ -1113,6 +1134,7 @@ on_context_stored_control_removed (MateMixerContext *context,
                                    const gchar      *name,
                                    GvcMixerDialog   *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         GtkWidget *bar;
 
         bar = g_hash_table_lookup (dialog->priv->bars, name);
@@ -1237,6 +1259,7 @@ on_device_profile_active_option_notify (MateMixerDeviceSwitch *swtch,
                                         GParamSpec            *pspec,
                                         GvcMixerDialog        *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerDevice *device;
 
         device = mate_mixer_device_switch_get_device (swtch);
@@ -1300,6 +1323,7 @@ add_device (GvcMixerDialog *dialog, MateMixerDevice *device)
 static void
 on_context_device_added (MateMixerContext *context, const gchar *name, GvcMixerDialog *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerDevice *device;
 
         device = mate_mixer_context_get_device (context, name);
@@ -1314,6 +1338,7 @@ on_context_device_removed (MateMixerContext *context,
                            const gchar      *name,
                            GvcMixerDialog   *dialog)
 {
+        GVC_TRACE_FUNCTION ();
         GtkTreeIter   iter;
         GtkTreeModel *model;
 
@@ -1568,12 +1593,14 @@ on_device_profile_changing (GvcComboBox           *combobox,
 static void
 on_test_speakers_clicked (GvcComboBox *widget, GvcMixerDialog *dialog)
 {
-        GtkWidget       *d,
-                        *test,
-                        *container;
-        gchar           *title;
-        MateMixerDevice *device;
-        MateMixerStream *stream;
+        GtkWidget              *d,
+                               *test,
+                               *container;
+        gchar                  *title;
+        MateMixerDevice        *device;
+        MateMixerStream        *stream;
+        MateMixerStream        *input;
+        MateMixerStreamControl *input_control = NULL;
 
         device = g_object_get_data (G_OBJECT (widget), "device");
         if (G_UNLIKELY (device == NULL)) {
@@ -1594,11 +1621,21 @@ on_test_speakers_clicked (GvcComboBox *widget, GvcMixerDialog *dialog)
                                          GTK_WINDOW (dialog),
                                          GTK_DIALOG_MODAL |
                                          GTK_DIALOG_DESTROY_WITH_PARENT,
+                                         _("Check _Loopback"),
+                                         SPEAKER_TEST_RESPONSE_LOOPBACK,
+                                         _("Test _All"),
+                                         SPEAKER_TEST_RESPONSE_ALL,
                                          "gtk-close",
                                          GTK_RESPONSE_CLOSE,
                                          NULL);
         g_free (title);
 
+        gtk_widget_set_tooltip_text (gtk_dialog_get_widget_for_response (GTK_DIALOG (d),
+                                                                         SPEAKER_TEST_RESPONSE_LOOPBACK),
+                                     _("Checks whether the default input hears each speaker. "
+                                       "The delay shown is rough and not suitable to synchronize "
+                                       "audio and video."));
+
         gtk_window_set_resizable (GTK_WINDOW (d), FALSE);
 
         test = gvc_speaker_test_new (stream);
@@ -1607,8 +1644,37 @@ on_test_speakers_clicked (GvcComboBox *widget, GvcMixerDialog *dialog)
         container = gtk_dialog_get_content_area (GTK_DIALOG (d));
         gtk_container_add (GTK_CONTAINER (container), test);
 
-        gtk_dialog_run (GTK_DIALOG (d));
+        /* The loopback is checked with the peak level monitor of the
+         * default input, keep a reference as the input may go away while
+         * the dialog runs */
+        input = mate_mixer_context_get_default_input_stream (dialog->priv->context);
+        if (input != NULL)
+                input_control = mate_mixer_stream_get_default_control (input);
+
+        if (input_control != NULL &&
+            (mate_mixer_stream_control_get_flags (input_control) & MATE_MIXER_STREAM_CONTROL_HAS_MONITOR)) {
+                g_object_ref (input_control);
+        } else {
+                input_control = NULL;
+                gtk_dialog_set_response_sensitive (GTK_DIALOG (d),
+                                                   SPEAKER_TEST_RESPONSE_LOOPBACK,
+                                                   FALSE);
+        }
+
+        while (TRUE) {
+                gint response = gtk_dialog_run (GTK_DIALOG (d));
+
+                if (response == SPEAKER_TEST_RESPONSE_ALL)
+                        gvc_speaker_test_play_all (GVC_SPEAKER_TEST (test));
+                else if (response == SPEAKER_TEST_RESPONSE_LOOPBACK)
+                        gvc_speaker_test_check_loopback (GVC_SPEAKER_TEST (test), input_control);
+                else
+                        break;
+        }
+
         gtk_widget_destroy (d);
+
+        g_clear_object (&input_control);
 }
 
 static void
@@ -2272,6 +2338,10 @@ gvc_mixer_dialog_constructor (GType                  type,
 
         gtk_widget_show_all (main_vbox);
 
+        gvc_frame_overlay_attach (GTK_WIDGET (self));
+
+        gvc_startup_profile_mark ("dialog widgets built");
+
         list = mate_mixer_context_list_streams (self->priv->context);
         while (list != NULL) {
                 add_stream (self, MATE_MIXER_STREAM (list->data));
@@ -2284,6 +2354,8 @@ gvc_mixer_dialog_constructor (GType                  type,
                 list = list->next;
         }
 
+        gvc_startup_profile_mark ("streams and devices added");
+
         selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (self->priv->hw_treeview));
 
         /* Select the first device in the list */
@@ -2309,6 +2381,7 @@ static void
 gvc_mixer_dialog_set_context (GvcMixerDialog *dialog, MateMixerContext *context)
 {
         dialog->priv->context = g_object_ref (context);
+        gvc_trace_watch (context);
 
         g_signal_connect (G_OBJECT (dialog->priv->context),
                           "stream-added",
@@ -0,0 +1,689 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include <libmatemixer/matemixer.h>
+
+#include "gvc-mixer-service.h"
+#include "gvc-mixer-state.h"
+
+/* Exports the state of the mixer on the session bus, so that other
+ * components do not need their own connection to the sound system */
+
+struct _GvcMixerServicePrivate
+{
+        MateMixerContext *context;
+        GDBusConnection  *connection;
+        guint             registration_id;
+        guint             update_id;
+        GVariant        **values;
+        GVariant         *restore;
+        guint             restore_id;
+};
+
+/* How long the streams of a device are given to appear after a snapshot
+ * selected a different profile */
+#define RESTORE_SETTLE_MS  500
+
+enum {
+        DBUS_PROP_DEFAULT_OUTPUT,
+        DBUS_PROP_DEFAULT_INPUT,
+        DBUS_PROP_OUTPUT_VOLUME,
+        DBUS_PROP_OUTPUT_MUTE,
+        DBUS_PROP_INPUT_VOLUME,
+        DBUS_PROP_INPUT_MUTE,
+        DBUS_PROP_APPLICATIONS,
+        N_DBUS_PROPERTIES
+};
+
+static const gchar *dbus_property_names[N_DBUS_PROPERTIES] = {
+        "DefaultOutput",
+        "DefaultInput",
+        "OutputVolume",
+        "OutputMute",
+        "InputVolume",
+        "InputMute",
+        "Applications"
+};
+
+static const gchar introspection_xml[] =
+        "<node>"
+        "  <interface name='" GVC_MIXER_SERVICE_DBUS_INTERFACE "'>"
+        "    <property name='DefaultOutput' type='s' access='read'/>"
+        "    <property name='DefaultInput' type='s' access='read'/>"
+        "    <property name='OutputVolume' type='u' access='read'/>"
+        "    <property name='OutputMute' type='b' access='read'/>"
+        "    <property name='InputVolume' type='u' access='read'/>"
+        "    <property name='InputMute' type='b' access='read'/>"
+        "    <!-- (control name, application name, volume, mute) -->"
+        "    <property name='Applications' type='a(ssub)' access='read'/>"
+        "    <method name='Apply'>"
+        "      <arg name='changes' type='a(ssv)' direction='in'/>"
+        "      <arg name='applied' type='u' direction='out'/>"
+        "    </method>"
+        "    <method name='Capture'>"
+        "      <arg name='state' type='a(ssv)' direction='out'/>"
+        "    </method>"
+        "    <method name='SaveSnapshot'>"
+        "      <arg name='name' type='s' direction='in'/>"
+        "    </method>"
+        "    <method name='RestoreSnapshot'>"
+        "      <arg name='name' type='s' direction='in'/>"
+        "      <arg name='applied' type='u' direction='out'/>"
+        "    </method>"
+        "  </interface>"
+        "</node>";
+
+static const GDBusErrorEntry dbus_error_entries[] = {
+        { GVC_MIXER_STATE_ERROR_NOT_FOUND, "org.mate.VolumeControl.Error.NotFound" },
+        { GVC_MIXER_STATE_ERROR_INVALID,   "org.mate.VolumeControl.Error.Invalid" },
+        { GVC_MIXER_STATE_ERROR_FAILED,    "org.mate.VolumeControl.Error.Failed" }
+};
+
+static GDBusNodeInfo *introspection_data = NULL;
+
+static void gvc_mixer_service_dispose  (GObject *object);
+static void gvc_mixer_service_finalize (GObject *object);
+
+static void watch_stream (GvcMixerService *service, MateMixerStream *stream);
+
+G_DEFINE_TYPE_WITH_PRIVATE (GvcMixerService, gvc_mixer_service, G_TYPE_OBJECT)
+
+static GVariant *
+stream_name_value (MateMixerStream *stream)
+{
+        return g_variant_new_string ((stream != NULL) ? mate_mixer_stream_get_name (stream) : "");
+}
+
+static GVariant *
+stream_volume_value (MateMixerStream *stream)
+{
+        MateMixerStreamControl *control = NULL;
+
+        if (stream != NULL)
+                control = mate_mixer_stream_get_default_control (stream);
+
+        return g_variant_new_uint32 ((control != NULL) ? gvc_mixer_state_volume_percent (control) : 0);
+}
+
+static GVariant *
+stream_mute_value (MateMixerStream *stream)
+{
+        MateMixerStreamControl *control = NULL;
+
+        if (stream != NULL)
+                control = mate_mixer_stream_get_default_control (stream);
+
+        return g_variant_new_boolean ((control != NULL) ? mate_mixer_stream_control_get_mute (control) : FALSE);
+}
+
+static GVariant *
+applications_value (MateMixerContext *context)
+{
+        GVariantBuilder builder;
+        const GList    *streams;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssub)"));
+
+        for (streams = mate_mixer_context_list_streams (context); streams != NULL; streams = streams->next) {
+                const GList *controls;
+
+                controls = mate_mixer_stream_list_controls (MATE_MIXER_STREAM (streams->data));
+                while (controls != NULL) {
+                        MateMixerStreamControl *control = MATE_MIXER_STREAM_CONTROL (controls->data);
+                        MateMixerAppInfo       *info;
+                        const gchar            *app_name = NULL;
+
+                        controls = controls->next;
+
+                        if (mate_mixer_stream_control_get_role (control) != MATE_MIXER_STREAM_CONTROL_ROLE_APPLICATION)
+                                continue;
+
+                        info = mate_mixer_stream_control_get_app_info (control);
+                        if (info != NULL)
+                                app_name = mate_mixer_app_info_get_name (info);
+                        if (app_name == NULL)
+                                app_name = mate_mixer_stream_control_get_label (control);
+
+                        g_variant_builder_add (&builder, "(ssub)",
+                                               mate_mixer_stream_control_get_name (control),
+                                               (app_name != NULL) ? app_name : "",
+                                               gvc_mixer_state_volume_percent (control),
+                                               mate_mixer_stream_control_get_mute (control));
+                }
+        }
+        return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+get_property_value (GvcMixerService *service, guint property)
+{
+        MateMixerContext *context = service->priv->context;
+
+        switch (property) {
+        case DBUS_PROP_DEFAULT_OUTPUT:
+                return stream_name_value (mate_mixer_context_get_default_output_stream (context));
+        case DBUS_PROP_DEFAULT_INPUT:
+                return stream_name_value (mate_mixer_context_get_default_input_stream (context));
+        case DBUS_PROP_OUTPUT_VOLUME:
+                return stream_volume_value (mate_mixer_context_get_default_output_stream (context));
+        case DBUS_PROP_OUTPUT_MUTE:
+                return stream_mute_value (mate_mixer_context_get_default_output_stream (context));
+        case DBUS_PROP_INPUT_VOLUME:
+                return stream_volume_value (mate_mixer_context_get_default_input_stream (context));
+        case DBUS_PROP_INPUT_MUTE:
+                return stream_mute_value (mate_mixer_context_get_default_input_stream (context));
+        case DBUS_PROP_APPLICATIONS:
+                return applications_value (context);
+        }
+        g_assert_not_reached ();
+        return NULL;
+}
+
+/* Emits a single PropertiesChanged signal with the properties whose
+ * value differs from the last one sent */
+static gboolean
+update_properties (GvcMixerService *service)
+{
+        GVariantBuilder builder;
+        gboolean        changed = FALSE;
+        guint           i;
+
+        service->priv->update_id = 0;
+
+        if (service->priv->registration_id == 0)
+                return G_SOURCE_REMOVE;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+
+        for (i = 0; i < N_DBUS_PROPERTIES; i++) {
+                GVariant *value = g_variant_ref_sink (get_property_value (service, i));
+
+                if (service->priv->values[i] != NULL && g_variant_equal (value, service->priv->values[i])) {
+                        g_variant_unref (value);
+                        continue;
+                }
+
+                g_variant_builder_add (&builder, "{sv}", dbus_property_names[i], value);
+
+                if (service->priv->values[i] != NULL)
+                        g_variant_unref (service->priv->values[i]);
+
+                service->priv->values[i] = value;
+                changed = TRUE;
+        }
+
+        if (changed == FALSE) {
+                g_variant_builder_clear (&builder);
+                return G_SOURCE_REMOVE;
+        }
+
+        g_dbus_connection_emit_signal (service->priv->connection,
+                                       NULL,
+                                       GVC_MIXER_SERVICE_DBUS_PATH,
+                                       "org.freedesktop.DBus.Properties",
+                                       "PropertiesChanged",
+                                       g_variant_new ("(sa{sv}as)",
+                                                      GVC_MIXER_SERVICE_DBUS_INTERFACE,
+                                                      &builder,
+                                                      NULL),
+                                       NULL);
+        return G_SOURCE_REMOVE;
+}
+
+/* Remembers the current values without announcing them, the clients
+ * read them when they start watching */
+static void
+seed_properties (GvcMixerService *service)
+{
+        guint i;
+
+        for (i = 0; i < N_DBUS_PROPERTIES; i++) {
+                if (service->priv->values[i] != NULL)
+                        g_variant_unref (service->priv->values[i]);
+
+                service->priv->values[i] = g_variant_ref_sink (get_property_value (service, i));
+        }
+}
+
+static void
+queue_update (GvcMixerService *service)
+{
+        if (service->priv->update_id != 0 || service->priv->registration_id == 0)
+                return;
+
+        service->priv->update_id = g_idle_add ((GSourceFunc) update_properties, service);
+}
+
+static void
+watch_control (GvcMixerService *service, MateMixerStreamControl *control)
+{
+        g_signal_connect_object (G_OBJECT (control),
+                                 "notify::volume",
+                                 G_CALLBACK (queue_update),
+                                 service,
+                                 G_CONNECT_SWAPPED);
+        g_signal_connect_object (G_OBJECT (control),
+                                 "notify::mute",
+                                 G_CALLBACK (queue_update),
+                                 service,
+                                 G_CONNECT_SWAPPED);
+}
+
+static void
+on_stream_control_added (MateMixerStream *stream,
+                         const gchar     *name,
+                         GvcMixerService *service)
+{
+        MateMixerStreamControl *control;
+
+        control = mate_mixer_stream_get_control (stream, name);
+        if (control != NULL)
+                watch_control (service, control);
+
+        queue_update (service);
+}
+
+static void
+watch_stream (GvcMixerService *service, MateMixerStream *stream)
+{
+        const GList *controls;
+
+        g_signal_connect_object (G_OBJECT (stream),
+                                 "control-added",
+                                 G_CALLBACK (on_stream_control_added),
+                                 service,
+                                 0);
+        g_signal_connect_object (G_OBJECT (stream),
+                                 "control-removed",
+                                 G_CALLBACK (queue_update),
+                                 service,
+                                 G_CONNECT_SWAPPED);
+
+        controls = mate_mixer_stream_list_controls (stream);
+        while (controls != NULL) {
+                watch_control (service, MATE_MIXER_STREAM_CONTROL (controls->data));
+                controls = controls->next;
+        }
+}
+
+static void
+on_context_stream_added (MateMixerContext *context,
+                         const gchar      *name,
+                         GvcMixerService  *service)
+{
+        MateMixerStream *stream;
+
+        /* The streams are only watched while the interface is exported,
+         * the export watches the streams which exist at that time */
+        if (service->priv->registration_id == 0)
+                return;
+
+        stream = mate_mixer_context_get_stream (context, name);
+        if (stream != NULL)
+                watch_stream (service, stream);
+
+        queue_update (service);
+}
+
+static void
+unwatch_streams (GvcMixerService *service)
+{
+        const GList *streams;
+
+        streams = mate_mixer_context_list_streams (service->priv->context);
+        while (streams != NULL) {
+                const GList *controls;
+
+                controls = mate_mixer_stream_list_controls (MATE_MIXER_STREAM (streams->data));
+                while (controls != NULL) {
+                        g_signal_handlers_disconnect_by_data (G_OBJECT (controls->data), service);
+                        controls = controls->next;
+                }
+
+                g_signal_handlers_disconnect_by_data (G_OBJECT (streams->data), service);
+                streams = streams->next;
+        }
+}
+
+/* Applies the rest of a snapshot, the changes of the streams which were
+ * missing on the first pass */
+static gboolean
+restore_settled (GvcMixerService *service)
+{
+        GError *error = NULL;
+
+        service->priv->restore_id = 0;
+
+        if (gvc_mixer_state_apply (service->priv->context,
+                                   service->priv->restore,
+                                   GVC_MIXER_STATE_APPLY_SKIP_MISSING,
+                                   NULL,
+                                   &error) == FALSE) {
+                g_warning ("Failed to restore a snapshot: %s", error->message);
+                g_error_free (error);
+        }
+
+        g_clear_pointer (&service->priv->restore, g_variant_unref);
+        return G_SOURCE_REMOVE;
+}
+
+static gboolean
+restore_snapshot (GvcMixerService *service,
+                  const gchar     *name,
+                  guint           *applied,
+                  GError         **error)
+{
+        GVariant *state;
+
+        state = gvc_mixer_state_load_snapshot (name, error);
+        if (state == NULL)
+                return FALSE;
+
+        if (gvc_mixer_state_apply (service->priv->context,
+                                   state,
+                                   GVC_MIXER_STATE_APPLY_SKIP_MISSING,
+                                   applied,
+                                   error) == FALSE) {
+                g_variant_unref (state);
+                return FALSE;
+        }
+
+        if (service->priv->restore_id != 0) {
+                g_source_remove (service->priv->restore_id);
+                service->priv->restore_id = 0;
+        }
+        g_clear_pointer (&service->priv->restore, g_variant_unref);
+
+        /* Nothing else can follow when nothing changed */
+        if (*applied == 0) {
+                g_variant_unref (state);
+                return TRUE;
+        }
+
+        service->priv->restore    = state;
+        service->priv->restore_id = g_timeout_add (RESTORE_SETTLE_MS,
+                                                   (GSourceFunc) restore_settled,
+                                                   service);
+        return TRUE;
+}
+
+static void
+handle_method_call (GDBusConnection       *connection,
+                    const gchar           *sender,
+                    const gchar           *object_path,
+                    const gchar           *interface_name,
+                    const gchar           *method_name,
+                    GVariant              *parameters,
+                    GDBusMethodInvocation *invocation,
+                    gpointer               user_data)
+{
+        GvcMixerService *service = GVC_MIXER_SERVICE (user_data);
+
+        if (g_strcmp0 (method_name, "Apply") == 0) {
+                GVariant *changes;
+                GError   *error = NULL;
+                guint     applied;
+
+                changes = g_variant_get_child_value (parameters, 0);
+
+                if (gvc_mixer_state_apply (service->priv->context,
+                                           changes,
+                                           GVC_MIXER_STATE_APPLY_NONE,
+                                           &applied,
+                                           &error) == TRUE)
+                        g_dbus_method_invocation_return_value (invocation,
+                                                               g_variant_new ("(u)", applied));
+                else
+                        g_dbus_method_invocation_take_error (invocation, error);
+
+                g_variant_unref (changes);
+        }
+        else if (g_strcmp0 (method_name, "Capture") == 0) {
+                GVariant *state;
+
+                state = gvc_mixer_state_capture (service->priv->context);
+
+                g_dbus_method_invocation_return_value (invocation,
+                                                       g_variant_new_tuple (&state, 1));
+        }
+        else if (g_strcmp0 (method_name, "SaveSnapshot") == 0) {
+                const gchar *name;
+                GError      *error = NULL;
+
+                g_variant_get (parameters, "(&s)", &name);
+
+                if (gvc_mixer_state_save_snapshot (gvc_mixer_state_capture (service->priv->context),
+                                                   name,
+                                                   &error) == TRUE)
+                        g_dbus_method_invocation_return_value (invocation, NULL);
+                else
+                        g_dbus_method_invocation_take_error (invocation, error);
+        }
+        else if (g_strcmp0 (method_name, "RestoreSnapshot") == 0) {
+                const gchar *name;
+                GError      *error = NULL;
+                guint        applied;
+
+                g_variant_get (parameters, "(&s)", &name);
+
+                if (restore_snapshot (service, name, &applied, &error) == TRUE)
+                        g_dbus_method_invocation_return_value (invocation,
+                                                               g_variant_new ("(u)", applied));
+                else
+                        g_dbus_method_invocation_take_error (invocation, error);
+        }
+}
+
+static GVariant *
+handle_get_property (GDBusConnection  *connection,
+                     const gchar      *sender,
+                     const gchar      *object_path,
+                     const gchar      *interface_name,
+                     const gchar      *property_name,
+                     GError          **error,
+                     gpointer          user_data)
+{
+        GvcMixerService *service = GVC_MIXER_SERVICE (user_data);
+        guint            i;
+
+        for (i = 0; i < N_DBUS_PROPERTIES; i++)
+                if (g_strcmp0 (property_name, dbus_property_names[i]) == 0)
+                        return get_property_value (service, i);
+
+        return NULL;
+}
+
+static const GDBusInterfaceVTable interface_vtable = {
+        handle_method_call,
+        handle_get_property,
+        NULL
+};
+
+/**
+ * gvc_mixer_service_export:
+ * @service: a #GvcMixerService
+ * @connection: the connection to export the service on
+ * @error: return location for a #GError
+ *
+ * Exports the mixer interface on %GVC_MIXER_SERVICE_DBUS_PATH, the
+ * context must be ready.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gvc_mixer_service_export (GvcMixerService  *service,
+                          GDBusConnection  *connection,
+                          GError          **error)
+{
+        const GList *streams;
+
+        g_return_val_if_fail (GVC_IS_MIXER_SERVICE (service), FALSE);
+        g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), FALSE);
+
+        if (service->priv->registration_id != 0)
+                return TRUE;
+
+        service->priv->registration_id =
+                g_dbus_connection_register_object (connection,
+                                                   GVC_MIXER_SERVICE_DBUS_PATH,
+                                                   introspection_data->interfaces[0],
+                                                   &interface_vtable,
+                                                   service,
+                                                   NULL,
+                                                   error);
+
+        if (service->priv->registration_id == 0)
+                return FALSE;
+
+        service->priv->connection = g_object_ref (connection);
+
+        streams = mate_mixer_context_list_streams (service->priv->context);
+        while (streams != NULL) {
+                watch_stream (service, MATE_MIXER_STREAM (streams->data));
+                streams = streams->next;
+        }
+
+        /* Remember the values the clients start from, so that the first
+         * update only announces what really changed */
+        seed_properties (service);
+        return TRUE;
+}
+
+void
+gvc_mixer_service_unexport (GvcMixerService *service)
+{
+        guint i;
+
+        g_return_if_fail (GVC_IS_MIXER_SERVICE (service));
+
+        if (service->priv->registration_id == 0)
+                return;
+
+        g_dbus_connection_unregister_object (service->priv->connection,
+                                             service->priv->registration_id);
+        service->priv->registration_id = 0;
+
+        g_clear_object (&service->priv->connection);
+
+        unwatch_streams (service);
+
+        if (service->priv->update_id != 0) {
+                g_source_remove (service->priv->update_id);
+                service->priv->update_id = 0;
+        }
+
+        for (i = 0; i < N_DBUS_PROPERTIES; i++)
+                g_clear_pointer (&service->priv->values[i], g_variant_unref);
+}
+
+static void
+gvc_mixer_service_dispose (GObject *object)
+{
+        GvcMixerService *service = GVC_MIXER_SERVICE (object);
+
+        gvc_mixer_service_unexport (service);
+
+        if (service->priv->restore_id != 0) {
+                g_source_remove (service->priv->restore_id);
+                service->priv->restore_id = 0;
+        }
+        g_clear_pointer (&service->priv->restore, g_variant_unref);
+
+        if (service->priv->context != NULL) {
+                g_signal_handlers_disconnect_by_data (G_OBJECT (service->priv->context),
+                                                      service);
+
+                g_clear_object (&service->priv->context);
+        }
+
+        G_OBJECT_CLASS (gvc_mixer_service_parent_class)->dispose (object);
+}
+
+static void
+gvc_mixer_service_finalize (GObject *object)
+{
+        GvcMixerService *service = GVC_MIXER_SERVICE (object);
+
+        g_free (service->priv->values);
+
+        G_OBJECT_CLASS (gvc_mixer_service_parent_class)->finalize (object);
+}
+
+static void
+gvc_mixer_service_class_init (GvcMixerServiceClass *klass)
+{
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
+        static gsize  error_domain = 0;
+
+        object_class->dispose  = gvc_mixer_service_dispose;
+        object_class->finalize = gvc_mixer_service_finalize;
+
+        introspection_data = g_dbus_node_info_new_for_xml (introspection_xml, NULL);
+        g_assert (introspection_data != NULL);
+
+        g_dbus_error_register_error_domain ("gvc-mixer-state-error-quark",
+                                            &error_domain,
+                                            dbus_error_entries,
+                                            G_N_ELEMENTS (dbus_error_entries));
+}
+
+static void
+gvc_mixer_service_init (GvcMixerService *service)
+{
+        service->priv = gvc_mixer_service_get_instance_private (service);
+
+        service->priv->values = g_new0 (GVariant *, N_DBUS_PROPERTIES);
+}
+
+GvcMixerService *
+gvc_mixer_service_new (MateMixerContext *context)
+{
+        GvcMixerService *service;
+
+        g_return_val_if_fail (MATE_MIXER_IS_CONTEXT (context), NULL);
+
+        service = g_object_new (GVC_TYPE_MIXER_SERVICE, NULL);
+
+        service->priv->context = g_object_ref (context);
+
+        g_signal_connect_swapped (G_OBJECT (context),
+                                  "notify::default-output-stream",
+                                  G_CALLBACK (queue_update),
+                                  service);
+        g_signal_connect_swapped (G_OBJECT (context),
+                                  "notify::default-input-stream",
+                                  G_CALLBACK (queue_update),
+                                  service);
+        g_signal_connect (G_OBJECT (context),
+                          "stream-added",
+                          G_CALLBACK (on_context_stream_added),
+                          service);
+        g_signal_connect_swapped (G_OBJECT (context),
+                                  "stream-removed",
+                                  G_CALLBACK (queue_update),
+                                  service);
+        return service;
+}
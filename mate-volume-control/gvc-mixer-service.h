@@ -0,0 +1,68 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __GVC_MIXER_SERVICE_H
+#define __GVC_MIXER_SERVICE_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include <libmatemixer/matemixer.h>
+
+G_BEGIN_DECLS
+
+#define GVC_MIXER_SERVICE_DBUS_PATH       "/org/mate/VolumeControl"
+#define GVC_MIXER_SERVICE_DBUS_INTERFACE  "org.mate.VolumeControl.Mixer"
+
+#define GVC_TYPE_MIXER_SERVICE         (gvc_mixer_service_get_type ())
+#define GVC_MIXER_SERVICE(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), GVC_TYPE_MIXER_SERVICE, GvcMixerService))
+#define GVC_MIXER_SERVICE_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), GVC_TYPE_MIXER_SERVICE, GvcMixerServiceClass))
+#define GVC_IS_MIXER_SERVICE(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), GVC_TYPE_MIXER_SERVICE))
+#define GVC_IS_MIXER_SERVICE_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), GVC_TYPE_MIXER_SERVICE))
+#define GVC_MIXER_SERVICE_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), GVC_TYPE_MIXER_SERVICE, GvcMixerServiceClass))
+
+typedef struct _GvcMixerService         GvcMixerService;
+typedef struct _GvcMixerServiceClass    GvcMixerServiceClass;
+typedef struct _GvcMixerServicePrivate  GvcMixerServicePrivate;
+
+struct _GvcMixerService
+{
+        GObject                 parent;
+        GvcMixerServicePrivate *priv;
+};
+
+struct _GvcMixerServiceClass
+{
+        GObjectClass            parent_class;
+};
+
+GType               gvc_mixer_service_get_type        (void) G_GNUC_CONST;
+
+GvcMixerService *   gvc_mixer_service_new             (MateMixerContext *context);
+
+gboolean            gvc_mixer_service_export          (GvcMixerService  *service,
+                                                       GDBusConnection  *connection,
+                                                       GError          **error);
+void                gvc_mixer_service_unexport        (GvcMixerService  *service);
+
+G_END_DECLS
+
+#endif /* __GVC_MIXER_SERVICE_H */
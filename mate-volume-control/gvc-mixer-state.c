@@ -0,0 +1,775 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include <libmatemixer/matemixer.h>
+
+#include "gvc-mixer-state.h"
+
+typedef enum {
+        CHANGE_VOLUME,
+        CHANGE_CHANNELS,
+        CHANGE_MUTE,
+        CHANGE_DEFAULT,
+        CHANGE_SWITCH
+} ChangeType;
+
+/* A change checked against the current state, ready to be sent */
+typedef struct {
+        ChangeType              type;
+        MateMixerStream        *stream;
+        MateMixerStreamControl *control;
+        MateMixerSwitch        *swtch;
+        MateMixerSwitchOption  *option;
+        guint                   volume;
+        GVariant               *channels;
+        gboolean                mute;
+} Change;
+
+G_DEFINE_QUARK (gvc-mixer-state-error-quark, gvc_mixer_state_error)
+
+guint
+gvc_mixer_state_volume_percent (MateMixerStreamControl *control)
+{
+        guint normal;
+
+        g_return_val_if_fail (MATE_MIXER_IS_STREAM_CONTROL (control), 0);
+
+        normal = mate_mixer_stream_control_get_normal_volume (control);
+        if (normal == 0)
+                return 0;
+
+        return (guint) (((guint64) mate_mixer_stream_control_get_volume (control) * 100 + normal / 2) / normal);
+}
+
+static MateMixerStreamControl *
+find_stream_control (MateMixerContext *context, const gchar *name)
+{
+        const GList *list;
+
+        for (list = mate_mixer_context_list_streams (context); list != NULL; list = list->next) {
+                MateMixerStreamControl *control;
+
+                control = mate_mixer_stream_get_control (MATE_MIXER_STREAM (list->data), name);
+                if (control != NULL)
+                        return control;
+        }
+        return MATE_MIXER_STREAM_CONTROL (mate_mixer_context_get_stored_control (context, name));
+}
+
+/* Finds what a target refers to, the volume of a stream is the one of
+ * its default control */
+static gboolean
+resolve_target (MateMixerContext        *context,
+                const gchar             *target,
+                MateMixerStream        **stream,
+                MateMixerStreamControl **control,
+                MateMixerDevice        **device,
+                GError                 **error)
+{
+        *stream  = NULL;
+        *control = NULL;
+        *device  = NULL;
+
+        if (strcmp (target, "output") == 0)
+                *stream = mate_mixer_context_get_default_output_stream (context);
+        else if (strcmp (target, "input") == 0)
+                *stream = mate_mixer_context_get_default_input_stream (context);
+        else if (g_str_has_prefix (target, "stream:"))
+                *stream = mate_mixer_context_get_stream (context, target + strlen ("stream:"));
+        else if (g_str_has_prefix (target, "control:"))
+                *control = find_stream_control (context, target + strlen ("control:"));
+        else if (g_str_has_prefix (target, "device:"))
+                *device = mate_mixer_context_get_device (context, target + strlen ("device:"));
+        else {
+                g_set_error (error,
+                             GVC_MIXER_STATE_ERROR,
+                             GVC_MIXER_STATE_ERROR_INVALID,
+                             _("Invalid target: %s"),
+                             target);
+                return FALSE;
+        }
+
+        if (*stream == NULL && *control == NULL && *device == NULL) {
+                g_set_error (error,
+                             GVC_MIXER_STATE_ERROR,
+                             GVC_MIXER_STATE_ERROR_NOT_FOUND,
+                             _("No such target: %s"),
+                             target);
+                return FALSE;
+        }
+
+        if (*stream != NULL)
+                *control = mate_mixer_stream_get_default_control (*stream);
+
+        return TRUE;
+}
+
+static gboolean
+check_value_type (GVariant           *value,
+                  const GVariantType *type,
+                  const gchar        *property,
+                  GError            **error)
+{
+        if (g_variant_is_of_type (value, type))
+                return TRUE;
+
+        g_set_error (error,
+                     GVC_MIXER_STATE_ERROR,
+                     GVC_MIXER_STATE_ERROR_INVALID,
+                     _("Invalid value for %s"),
+                     property);
+        return FALSE;
+}
+
+/* Checks a change and finds whether it is needed at all */
+static gboolean
+prepare_change (MateMixerContext *context,
+                const gchar      *target,
+                const gchar      *property,
+                GVariant         *value,
+                Change           *change,
+                gboolean         *needed,
+                GError          **error)
+{
+        MateMixerStream        *stream;
+        MateMixerStreamControl *control;
+        MateMixerDevice        *device;
+
+        if (resolve_target (context, target, &stream, &control, &device, error) == FALSE)
+                return FALSE;
+
+        memset (change, 0, sizeof (Change));
+        *needed = FALSE;
+
+        if (strcmp (property, "volume") == 0 && control != NULL) {
+                guint64 volume;
+
+                if (check_value_type (value, G_VARIANT_TYPE_UINT32, property, error) == FALSE)
+                        return FALSE;
+
+                if (!(mate_mixer_stream_control_get_flags (control) & MATE_MIXER_STREAM_CONTROL_VOLUME_WRITABLE))
+                        goto not_writable;
+
+                volume = (guint64) g_variant_get_uint32 (value) *
+                         mate_mixer_stream_control_get_normal_volume (control) / 100;
+                volume = CLAMP (volume,
+                                mate_mixer_stream_control_get_min_volume (control),
+                                mate_mixer_stream_control_get_max_volume (control));
+
+                change->type    = CHANGE_VOLUME;
+                change->control = control;
+                change->volume  = (guint) volume;
+
+                *needed = change->volume != mate_mixer_stream_control_get_volume (control);
+                return TRUE;
+        }
+
+        if (strcmp (property, "channels") == 0 && control != NULL) {
+                const guint32 *volumes;
+                gsize          n_volumes;
+                guint          i;
+
+                if (check_value_type (value, G_VARIANT_TYPE ("au"), property, error) == FALSE)
+                        return FALSE;
+
+                if (!(mate_mixer_stream_control_get_flags (control) & MATE_MIXER_STREAM_CONTROL_VOLUME_WRITABLE))
+                        goto not_writable;
+
+                volumes = g_variant_get_fixed_array (value, &n_volumes, sizeof (guint32));
+
+                /* The channel map changes with the profile, the volumes
+                 * would not mean the same then */
+                if (n_volumes != mate_mixer_stream_control_get_num_channels (control)) {
+                        g_set_error (error,
+                                     GVC_MIXER_STATE_ERROR,
+                                     GVC_MIXER_STATE_ERROR_INVALID,
+                                     _("Invalid value for %s"),
+                                     property);
+                        return FALSE;
+                }
+
+                change->type    = CHANGE_CHANNELS;
+                change->control = control;
+
+                for (i = 0; i < n_volumes; i++)
+                        if (volumes[i] != mate_mixer_stream_control_get_channel_volume (control, i)) {
+                                *needed = TRUE;
+                                break;
+                        }
+
+                if (*needed == TRUE)
+                        change->channels = g_variant_ref (value);
+                return TRUE;
+        }
+
+        if (strcmp (property, "mute") == 0 && control != NULL) {
+                if (check_value_type (value, G_VARIANT_TYPE_BOOLEAN, property, error) == FALSE)
+                        return FALSE;
+
+                if (!(mate_mixer_stream_control_get_flags (control) & MATE_MIXER_STREAM_CONTROL_MUTE_WRITABLE))
+                        goto not_writable;
+
+                change->type    = CHANGE_MUTE;
+                change->control = control;
+                change->mute    = g_variant_get_boolean (value);
+
+                *needed = change->mute != mate_mixer_stream_control_get_mute (control);
+                return TRUE;
+        }
+
+        if (strcmp (property, "default") == 0 && stream != NULL) {
+                MateMixerStream *current;
+
+                if (check_value_type (value, G_VARIANT_TYPE_BOOLEAN, property, error) == FALSE)
+                        return FALSE;
+
+                /* There is no way to unset a default stream */
+                if (g_variant_get_boolean (value) == FALSE) {
+                        g_set_error (error,
+                                     GVC_MIXER_STATE_ERROR,
+                                     GVC_MIXER_STATE_ERROR_INVALID,
+                                     _("Invalid value for %s"),
+                                     property);
+                        return FALSE;
+                }
+
+                if (mate_mixer_stream_get_direction (stream) == MATE_MIXER_DIRECTION_INPUT)
+                        current = mate_mixer_context_get_default_input_stream (context);
+                else
+                        current = mate_mixer_context_get_default_output_stream (context);
+
+                change->type   = CHANGE_DEFAULT;
+                change->stream = stream;
+
+                *needed = stream != current;
+                return TRUE;
+        }
+
+        if (g_str_has_prefix (property, "switch:") && (stream != NULL || device != NULL)) {
+                const gchar *name = property + strlen ("switch:");
+
+                if (check_value_type (value, G_VARIANT_TYPE_STRING, property, error) == FALSE)
+                        return FALSE;
+
+                if (stream != NULL)
+                        change->swtch = mate_mixer_stream_get_switch (stream, name);
+                else
+                        change->swtch = mate_mixer_device_get_switch (device, name);
+
+                if (change->swtch == NULL) {
+                        g_set_error (error,
+                                     GVC_MIXER_STATE_ERROR,
+                                     GVC_MIXER_STATE_ERROR_NOT_FOUND,
+                                     _("No such switch: %s"),
+                                     name);
+                        return FALSE;
+                }
+
+                change->option = mate_mixer_switch_get_option (change->swtch,
+                                                               g_variant_get_string (value, NULL));
+                if (change->option == NULL) {
+                        g_set_error (error,
+                                     GVC_MIXER_STATE_ERROR,
+                                     GVC_MIXER_STATE_ERROR_NOT_FOUND,
+                                     _("No such option: %s"),
+                                     g_variant_get_string (value, NULL));
+                        return FALSE;
+                }
+
+                change->type = CHANGE_SWITCH;
+
+                *needed = change->option != mate_mixer_switch_get_active_option (change->swtch);
+                return TRUE;
+        }
+
+        g_set_error (error,
+                     GVC_MIXER_STATE_ERROR,
+                     GVC_MIXER_STATE_ERROR_INVALID,
+                     _("Invalid property of %s: %s"),
+                     target,
+                     property);
+        return FALSE;
+
+not_writable:
+        g_set_error (error,
+                     GVC_MIXER_STATE_ERROR,
+                     GVC_MIXER_STATE_ERROR_FAILED,
+                     _("The %s of %s cannot be changed"),
+                     property,
+                     target);
+        return FALSE;
+}
+
+static gboolean
+send_change (MateMixerContext *context, Change *change)
+{
+        switch (change->type) {
+        case CHANGE_VOLUME:
+                return mate_mixer_stream_control_set_volume (change->control, change->volume);
+        case CHANGE_CHANNELS: {
+                const guint32 *volumes;
+                gsize          n_volumes;
+                guint          i;
+
+                volumes = g_variant_get_fixed_array (change->channels, &n_volumes, sizeof (guint32));
+
+                for (i = 0; i < n_volumes; i++) {
+                        guint volume = CLAMP (volumes[i],
+                                              mate_mixer_stream_control_get_min_volume (change->control),
+                                              mate_mixer_stream_control_get_max_volume (change->control));
+
+                        if (mate_mixer_stream_control_set_channel_volume (change->control, i, volume) == FALSE)
+                                return FALSE;
+                }
+                return TRUE;
+        }
+        case CHANGE_MUTE:
+                return mate_mixer_stream_control_set_mute (change->control, change->mute);
+        case CHANGE_DEFAULT:
+                if (mate_mixer_stream_get_direction (change->stream) == MATE_MIXER_DIRECTION_INPUT)
+                        return mate_mixer_context_set_default_input_stream (context, change->stream);
+                else
+                        return mate_mixer_context_set_default_output_stream (context, change->stream);
+        case CHANGE_SWITCH:
+                return mate_mixer_switch_set_active_option (change->swtch, change->option);
+        }
+        return FALSE;
+}
+
+/**
+ * gvc_mixer_state_apply:
+ * @context: a ready #MateMixerContext
+ * @changes: a list of changes of type %GVC_MIXER_STATE_CHANGES_TYPE
+ * @flags: flags of the #GvcMixerStateApplyFlags enumeration
+ * @n_applied: (out) (optional): the number of changes sent
+ * @error: return location for a #GError
+ *
+ * Checks every change first and does not send any of them if one is
+ * invalid. The changes which are already in effect are skipped, the
+ * rest is sent together without waiting for the sound system in
+ * between.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gvc_mixer_state_apply (MateMixerContext        *context,
+                       GVariant                *changes,
+                       GvcMixerStateApplyFlags  flags,
+                       guint                   *n_applied,
+                       GError                 **error)
+{
+        GArray       *needed;
+        GVariantIter  iter;
+        const gchar  *target;
+        const gchar  *property;
+        GVariant     *value;
+        gboolean      result = TRUE;
+        guint         i;
+
+        g_return_val_if_fail (MATE_MIXER_IS_CONTEXT (context), FALSE);
+        g_return_val_if_fail (g_variant_is_of_type (changes, GVC_MIXER_STATE_CHANGES_TYPE), FALSE);
+
+        needed = g_array_new (FALSE, FALSE, sizeof (Change));
+
+        g_variant_iter_init (&iter, changes);
+        while (g_variant_iter_next (&iter, "(&s&sv)", &target, &property, &value)) {
+                Change   change;
+                gboolean change_needed;
+                GError  *local_error = NULL;
+
+                result = prepare_change (context, target, property, value, &change, &change_needed, &local_error);
+                g_variant_unref (value);
+
+                if (result == FALSE) {
+                        if ((flags & GVC_MIXER_STATE_APPLY_SKIP_MISSING) &&
+                            g_error_matches (local_error, GVC_MIXER_STATE_ERROR, GVC_MIXER_STATE_ERROR_NOT_FOUND)) {
+                                g_clear_error (&local_error);
+                                result = TRUE;
+                                continue;
+                        }
+                        g_propagate_error (error, local_error);
+                        break;
+                }
+                if (change_needed == TRUE)
+                        g_array_append_val (needed, change);
+        }
+
+        if (n_applied != NULL)
+                *n_applied = 0;
+
+        for (i = 0; result == TRUE && i < needed->len; i++) {
+                Change *change = &g_array_index (needed, Change, i);
+
+                if (send_change (context, change) == FALSE) {
+                        g_set_error (error,
+                                     GVC_MIXER_STATE_ERROR,
+                                     GVC_MIXER_STATE_ERROR_FAILED,
+                                     _("The sound system refused a change"));
+                        result = FALSE;
+                } else if (n_applied != NULL) {
+                        (*n_applied)++;
+                }
+        }
+
+        for (i = 0; i < needed->len; i++) {
+                Change *change = &g_array_index (needed, Change, i);
+
+                if (change->channels != NULL)
+                        g_variant_unref (change->channels);
+        }
+
+        g_array_free (needed, TRUE);
+        return result;
+}
+
+static void
+capture_switches (GVariantBuilder *builder, const gchar *target, const GList *switches)
+{
+        while (switches != NULL) {
+                MateMixerSwitch       *swtch = MATE_MIXER_SWITCH (switches->data);
+                MateMixerSwitchOption *option;
+                gchar                 *property;
+
+                switches = switches->next;
+
+                option = mate_mixer_switch_get_active_option (swtch);
+                if (option == NULL)
+                        continue;
+
+                property = g_strdup_printf ("switch:%s", mate_mixer_switch_get_name (swtch));
+
+                g_variant_builder_add (builder, "(ssv)",
+                                       target,
+                                       property,
+                                       g_variant_new_string (mate_mixer_switch_option_get_name (option)));
+                g_free (property);
+        }
+}
+
+static void
+capture_control (GVariantBuilder *builder, const gchar *target, MateMixerStreamControl *control)
+{
+        MateMixerStreamControlFlags flags;
+        guint                       n_channels;
+
+        flags = mate_mixer_stream_control_get_flags (control);
+        n_channels = mate_mixer_stream_control_get_num_channels (control);
+
+        if ((flags & MATE_MIXER_STREAM_CONTROL_VOLUME_WRITABLE) && n_channels > 0) {
+                guint32 *volumes;
+                guint    i;
+
+                volumes = g_new (guint32, n_channels);
+                for (i = 0; i < n_channels; i++)
+                        volumes[i] = mate_mixer_stream_control_get_channel_volume (control, i);
+
+                g_variant_builder_add (builder, "(ssv)",
+                                       target,
+                                       "channels",
+                                       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                                                  volumes,
+                                                                  n_channels,
+                                                                  sizeof (guint32)));
+                g_free (volumes);
+        }
+
+        if (flags & MATE_MIXER_STREAM_CONTROL_MUTE_WRITABLE)
+                g_variant_builder_add (builder, "(ssv)",
+                                       target,
+                                       "mute",
+                                       g_variant_new_boolean (mate_mixer_stream_control_get_mute (control)));
+}
+
+/**
+ * gvc_mixer_state_capture:
+ * @context: a ready #MateMixerContext
+ *
+ * Captures the device profiles, the ports, the default streams, the
+ * channel volumes of every stream and the stored controls of the
+ * applications.
+ *
+ * The profiles come first as selecting one replaces the streams of the
+ * device, the rest may only apply once the new streams are there.
+ *
+ * Returns: (transfer floating): a list of changes which brings the
+ * mixer back to the current state.
+ */
+GVariant *
+gvc_mixer_state_capture (MateMixerContext *context)
+{
+        GVariantBuilder  builder;
+        const GList     *list;
+        MateMixerStream *stream;
+        gchar           *target;
+
+        g_return_val_if_fail (MATE_MIXER_IS_CONTEXT (context), NULL);
+
+        g_variant_builder_init (&builder, GVC_MIXER_STATE_CHANGES_TYPE);
+
+        for (list = mate_mixer_context_list_devices (context); list != NULL; list = list->next) {
+                MateMixerDevice *device = MATE_MIXER_DEVICE (list->data);
+
+                target = g_strdup_printf ("device:%s", mate_mixer_device_get_name (device));
+                capture_switches (&builder, target, mate_mixer_device_list_switches (device));
+                g_free (target);
+        }
+
+        stream = mate_mixer_context_get_default_output_stream (context);
+        if (stream != NULL) {
+                target = g_strdup_printf ("stream:%s", mate_mixer_stream_get_name (stream));
+                g_variant_builder_add (&builder, "(ssv)", target, "default", g_variant_new_boolean (TRUE));
+                g_free (target);
+        }
+
+        stream = mate_mixer_context_get_default_input_stream (context);
+        if (stream != NULL) {
+                target = g_strdup_printf ("stream:%s", mate_mixer_stream_get_name (stream));
+                g_variant_builder_add (&builder, "(ssv)", target, "default", g_variant_new_boolean (TRUE));
+                g_free (target);
+        }
+
+        for (list = mate_mixer_context_list_streams (context); list != NULL; list = list->next) {
+                MateMixerStreamControl *control;
+
+                stream = MATE_MIXER_STREAM (list->data);
+                target = g_strdup_printf ("stream:%s", mate_mixer_stream_get_name (stream));
+
+                capture_switches (&builder, target, mate_mixer_stream_list_switches (stream));
+
+                control = mate_mixer_stream_get_default_control (stream);
+                if (control != NULL)
+                        capture_control (&builder, target, control);
+
+                g_free (target);
+        }
+
+        for (list = mate_mixer_context_list_stored_controls (context); list != NULL; list = list->next) {
+                MateMixerStreamControl *control = MATE_MIXER_STREAM_CONTROL (list->data);
+
+                target = g_strdup_printf ("control:%s", mate_mixer_stream_control_get_name (control));
+                capture_control (&builder, target, control);
+                g_free (target);
+        }
+
+        return g_variant_builder_end (&builder);
+}
+
+static gboolean
+check_snapshot_name (const gchar *name, GError **error)
+{
+        if (name[0] != '\0' && name[0] != '.' && strchr (name, G_DIR_SEPARATOR) == NULL)
+                return TRUE;
+
+        g_set_error (error,
+                     GVC_MIXER_STATE_ERROR,
+                     GVC_MIXER_STATE_ERROR_INVALID,
+                     _("Invalid snapshot name: %s"),
+                     name);
+        return FALSE;
+}
+
+static gchar *
+get_snapshot_dir (void)
+{
+        return g_build_filename (g_get_user_config_dir (), "mate-volume-control", "snapshots", NULL);
+}
+
+/**
+ * gvc_mixer_state_save_snapshot:
+ * @state: a list of changes returned by gvc_mixer_state_capture()
+ * @name: the name of the snapshot
+ * @error: return location for a #GError
+ *
+ * Saves the serialized @state in the configuration directory of the
+ * user, replacing any snapshot of the same name. A floating @state is
+ * consumed.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gvc_mixer_state_save_snapshot (GVariant     *state,
+                               const gchar  *name,
+                               GError      **error)
+{
+        GVariant *data;
+        gchar    *dir;
+        gchar    *path;
+        gboolean  result = FALSE;
+
+        g_return_val_if_fail (g_variant_is_of_type (state, GVC_MIXER_STATE_CHANGES_TYPE), FALSE);
+        g_return_val_if_fail (name != NULL, FALSE);
+
+        g_variant_ref_sink (state);
+
+        if (check_snapshot_name (name, error) == FALSE) {
+                g_variant_unref (state);
+                return FALSE;
+        }
+
+        /* Snapshots are stored little endian */
+        if (G_BYTE_ORDER == G_BIG_ENDIAN)
+                data = g_variant_byteswap (state);
+        else
+                data = g_variant_get_normal_form (state);
+
+        dir = get_snapshot_dir ();
+        path = g_build_filename (dir, name, NULL);
+
+        if (g_mkdir_with_parents (dir, 0700) != 0) {
+                int errsv = errno;
+
+                g_set_error (error,
+                             G_FILE_ERROR,
+                             g_file_error_from_errno (errsv),
+                             _("Failed to create %s: %s"),
+                             dir,
+                             g_strerror (errsv));
+        } else {
+                result = g_file_set_contents (path,
+                                              g_variant_get_data (data),
+                                              g_variant_get_size (data),
+                                              error);
+        }
+
+        g_free (path);
+        g_free (dir);
+        g_variant_unref (data);
+        g_variant_unref (state);
+        return result;
+}
+
+/**
+ * gvc_mixer_state_load_snapshot:
+ * @name: the name of the snapshot
+ * @error: return location for a #GError
+ *
+ * Returns: (transfer full): the list of changes saved as @name, which
+ * is best applied with %GVC_MIXER_STATE_APPLY_SKIP_MISSING, or %NULL
+ * on failure.
+ */
+GVariant *
+gvc_mixer_state_load_snapshot (const gchar *name, GError **error)
+{
+        GVariant *state;
+        GBytes   *bytes;
+        gchar    *dir;
+        gchar    *path;
+        gchar    *contents;
+        gsize     length;
+        GError   *local_error = NULL;
+
+        g_return_val_if_fail (name != NULL, NULL);
+
+        if (check_snapshot_name (name, error) == FALSE)
+                return NULL;
+
+        dir = get_snapshot_dir ();
+        path = g_build_filename (dir, name, NULL);
+        g_free (dir);
+
+        if (g_file_get_contents (path, &contents, &length, &local_error) == FALSE) {
+                g_free (path);
+
+                if (g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+                        g_clear_error (&local_error);
+                        g_set_error (error,
+                                     GVC_MIXER_STATE_ERROR,
+                                     GVC_MIXER_STATE_ERROR_NOT_FOUND,
+                                     _("No such snapshot: %s"),
+                                     name);
+                } else
+                        g_propagate_error (error, local_error);
+
+                return NULL;
+        }
+        g_free (path);
+
+        bytes = g_bytes_new_take (contents, length);
+        state = g_variant_new_from_bytes (GVC_MIXER_STATE_CHANGES_TYPE, bytes, FALSE);
+        g_bytes_unref (bytes);
+
+        g_variant_ref_sink (state);
+
+        if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+                GVariant *swapped = g_variant_byteswap (state);
+
+                g_variant_unref (state);
+                state = swapped;
+        }
+
+        if (g_variant_is_normal_form (state) == FALSE) {
+                g_set_error (error,
+                             GVC_MIXER_STATE_ERROR,
+                             GVC_MIXER_STATE_ERROR_INVALID,
+                             _("Snapshot %s is damaged"),
+                             name);
+                g_variant_unref (state);
+                return NULL;
+        }
+        return state;
+}
+
+static gint
+compare_names (gconstpointer a, gconstpointer b)
+{
+        return g_strcmp0 (*(const gchar **) a, *(const gchar **) b);
+}
+
+/**
+ * gvc_mixer_state_list_snapshots:
+ *
+ * Returns: (transfer full): a sorted list of the saved snapshots.
+ */
+gchar **
+gvc_mixer_state_list_snapshots (void)
+{
+        GPtrArray   *names;
+        GDir        *gdir;
+        gchar       *dir;
+        const gchar *name;
+
+        names = g_ptr_array_new ();
+
+        dir = get_snapshot_dir ();
+        gdir = g_dir_open (dir, 0, NULL);
+        g_free (dir);
+
+        if (gdir != NULL) {
+                while ((name = g_dir_read_name (gdir)) != NULL)
+                        if (name[0] != '.')
+                                g_ptr_array_add (names, g_strdup (name));
+
+                g_dir_close (gdir);
+        }
+
+        g_ptr_array_sort (names, compare_names);
+        g_ptr_array_add (names, NULL);
+
+        return (gchar **) g_ptr_array_free (names, FALSE);
+}
@@ -0,0 +1,86 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __GVC_MIXER_STATE_H
+#define __GVC_MIXER_STATE_H
+
+#include <glib.h>
+
+#include <libmatemixer/matemixer.h>
+
+G_BEGIN_DECLS
+
+/* A list of changes is an "a(ssv)" variant of (target, property, value),
+ * the targets are:
+ *
+ *   "output", "input"  the default output or input stream
+ *   "stream:NAME"      a stream
+ *   "control:NAME"     a stream control or a stored control, such as
+ *                      the control of an application
+ *   "device:NAME"      a device
+ *
+ * and the properties:
+ *
+ *   "volume"           u, percent of the normal volume (streams, controls)
+ *   "channels"         au, volume of each channel, which also keeps the
+ *                      balance, fade and LFE (streams, controls)
+ *   "mute"             b (streams, controls)
+ *   "default"          b, only TRUE is accepted (streams)
+ *   "switch:NAME"      s, name of the option to select (streams, devices)
+ */
+#define GVC_MIXER_STATE_CHANGES_TYPE    ((const GVariantType *) "a(ssv)")
+
+#define GVC_MIXER_STATE_ERROR           (gvc_mixer_state_error_quark ())
+
+typedef enum {
+        GVC_MIXER_STATE_ERROR_NOT_FOUND,
+        GVC_MIXER_STATE_ERROR_INVALID,
+        GVC_MIXER_STATE_ERROR_FAILED
+} GvcMixerStateError;
+
+typedef enum {
+        GVC_MIXER_STATE_APPLY_NONE         = 0,
+        /* Skip the changes of targets which do not exist, such as a
+         * device unplugged since a snapshot was taken */
+        GVC_MIXER_STATE_APPLY_SKIP_MISSING = 1 << 0
+} GvcMixerStateApplyFlags;
+
+GQuark      gvc_mixer_state_error_quark     (void);
+
+guint       gvc_mixer_state_volume_percent  (MateMixerStreamControl *control);
+
+gboolean    gvc_mixer_state_apply           (MateMixerContext       *context,
+                                             GVariant               *changes,
+                                             GvcMixerStateApplyFlags flags,
+                                             guint                  *n_applied,
+                                             GError                **error);
+
+GVariant *  gvc_mixer_state_capture         (MateMixerContext       *context);
+
+gboolean    gvc_mixer_state_save_snapshot   (GVariant               *state,
+                                             const gchar            *name,
+                                             GError                **error);
+GVariant *  gvc_mixer_state_load_snapshot   (const gchar            *name,
+                                             GError                **error);
+gchar **    gvc_mixer_state_list_snapshots  (void);
+
+G_END_DECLS
+
+#endif /* __GVC_MIXER_STATE_H */
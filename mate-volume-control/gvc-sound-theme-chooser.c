@@ -48,8 +48,21 @@ struct GvcSoundThemeChooserPrivate
         GtkWidget *selection_box;
         GtkWidget *click_feedback_button;
         GSettings *sound_settings;
+        GCancellable *preview_cancellable;
+        GCancellable *probe_cancellable;
+        GHashTable *themes;
 };
 
+/* What is known about a theme in the combo box, resolved once when
+ * the theme indexes are loaded */
+typedef struct
+{
+        char                *name;
+        char                *parent;
+        char               **chain;
+        GtkTreeRowReference *row;
+} SoundThemeInfo;
+
 static void     gvc_sound_theme_chooser_dispose   (GObject            *object);
 
 G_DEFINE_TYPE_WITH_PRIVATE (GvcSoundThemeChooser, gvc_sound_theme_chooser, GTK_TYPE_BOX)
@@ -63,6 +76,11 @@ G_DEFINE_TYPE_WITH_PRIVATE (GvcSoundThemeChooser, gvc_sound_theme_chooser, GTK_T
 #define CUSTOM_THEME_NAME       "__custom"
 #define NO_SOUNDS_THEME_NAME    "__no_sounds"
 
+#define PREVIEW_EVENT_ID_PREFIX "mate-volume-control-preview:"
+
+/* The sound server limits the length of sample names */
+#define PREVIEW_EVENT_ID_MAX    127
+
 enum {
         THEME_DISPLAY_COL,
         THEME_IDENTIFIER_COL,
@@ -75,6 +93,9 @@ enum {
         ALERT_IDENTIFIER_COL,
         ALERT_SOUND_TYPE_COL,
         ALERT_ACTIVE_COL,
+        ALERT_DURATION_COL,
+        ALERT_CHANNELS_COL,
+        ALERT_RATE_COL,
         ALERT_NUM_COLS
 };
 
@@ -156,6 +177,28 @@ load_index_theme_name (const char *index,
         return indexname;
 }
 
+static SoundThemeInfo *
+sound_theme_info_new (char *name, char *parent)
+{
+        SoundThemeInfo *info;
+
+        info = g_new0 (SoundThemeInfo, 1);
+        info->name = name;
+        info->parent = parent;
+
+        return info;
+}
+
+static void
+sound_theme_info_free (SoundThemeInfo *info)
+{
+        g_free (info->name);
+        g_free (info->parent);
+        g_strfreev (info->chain);
+        gtk_tree_row_reference_free (info->row);
+        g_free (info);
+}
+
 static void
 sound_theme_in_dir (GHashTable *hash,
                     const char *dir)
@@ -169,7 +212,12 @@ sound_theme_in_dir (GHashTable *hash,
         }
 
         while ((name = g_dir_read_name (d)) != NULL) {
-                char *dirname, *index, *indexname;
+                char *dirname, *index, *indexname, *parent;
+
+                /* Skip hidden directories, such as the staging copies
+                 * of the custom theme */
+                if (name[0] == '.')
+                        continue;
 
                 /* Look for directories */
                 dirname = g_build_filename (dir, name, NULL);
@@ -183,75 +231,150 @@ sound_theme_in_dir (GHashTable *hash,
                 g_free (dirname);
 
                 /* Check the name of the theme in the index.theme file */
-                indexname = load_index_theme_name (index, NULL);
+                parent = NULL;
+                indexname = load_index_theme_name (index, &parent);
                 g_free (index);
                 if (indexname == NULL) {
+                        g_free (parent);
                         continue;
                 }
 
-                g_hash_table_insert (hash, g_strdup (name), indexname);
+                g_hash_table_insert (hash,
+                                     g_strdup (name),
+                                     sound_theme_info_new (indexname, parent));
         }
 
         g_dir_close (d);
 }
 
+/* Appends the ancestors of a theme to @chain, in lookup order:
+ * Inherits is a comma separated list, and each parent is followed
+ * by its own parents before moving to the next one */
 static void
-add_theme_to_store (const char   *key,
-                    const char   *value,
-                    GtkListStore *store)
+resolve_theme_chain (GHashTable *themes,
+                     const char *id,
+                     GPtrArray  *chain)
 {
-        char *parent;
+        SoundThemeInfo *info;
+        char          **parents;
+        guint           i;
 
-        parent = NULL;
+        info = g_hash_table_lookup (themes, id);
+        if (info == NULL || info->parent == NULL)
+                return;
 
-        /* Get the parent, if we're checking the custom theme */
-        if (strcmp (key, CUSTOM_THEME_NAME) == 0) {
-                char *name, *path;
+        parents = g_strsplit (info->parent, ",", -1);
+        for (i = 0; parents[i] != NULL; i++) {
+                const char *parent;
+                guint       j;
+                gboolean    seen;
 
-                path = custom_theme_dir_path ("index.theme");
-                name = load_index_theme_name (path, &parent);
-                g_free (name);
-                g_free (path);
+                parent = g_strstrip (parents[i]);
+                if (*parent == '\0')
+                        continue;
+
+                /* Guard against inheritance loops */
+                seen = FALSE;
+                for (j = 0; j < chain->len && !seen; j++)
+                        seen = strcmp (g_ptr_array_index (chain, j), parent) == 0;
+                if (seen)
+                        continue;
+
+                g_ptr_array_add (chain, g_strdup (parent));
+                resolve_theme_chain (themes, parent, chain);
         }
-        gtk_list_store_insert_with_values (store, NULL, G_MAXINT,
-                                           THEME_DISPLAY_COL, value,
-                                           THEME_IDENTIFIER_COL, key,
+        g_strfreev (parents);
+}
+
+static void
+update_theme_chain (GHashTable     *themes,
+                    const char     *id,
+                    SoundThemeInfo *info)
+{
+        GPtrArray *chain;
+
+        chain = g_ptr_array_new ();
+        g_ptr_array_add (chain, g_strdup (id));
+        resolve_theme_chain (themes, id, chain);
+        g_ptr_array_add (chain, NULL);
+
+        g_strfreev (info->chain);
+
+        /* Skip the theme itself */
+        info->chain = g_strdupv ((char **) chain->pdata + 1);
+        g_ptr_array_set_free_func (chain, g_free);
+        g_ptr_array_unref (chain);
+}
+
+static void
+add_theme_to_store (GvcSoundThemeChooser *chooser,
+                    GtkListStore         *store,
+                    const char           *id,
+                    SoundThemeInfo       *info)
+{
+        GtkTreeIter  iter;
+        GtkTreePath *path;
+        const char  *parent;
+
+        /* Only the custom theme shows its parent */
+        parent = NULL;
+        if (strcmp (id, CUSTOM_THEME_NAME) == 0)
+                parent = info->parent;
+
+        gtk_list_store_insert_with_values (store, &iter, G_MAXINT,
+                                           THEME_DISPLAY_COL, info->name,
+                                           THEME_IDENTIFIER_COL, id,
                                            THEME_PARENT_ID_COL, parent,
                                            -1);
-        g_free (parent);
+
+        path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), &iter);
+        gtk_tree_row_reference_free (info->row);
+        info->row = gtk_tree_row_reference_new (GTK_TREE_MODEL (store), path);
+        gtk_tree_path_free (path);
+}
+
+static const char *
+get_theme_parent (GvcSoundThemeChooser *chooser,
+                  const char           *id)
+{
+        SoundThemeInfo *info;
+
+        if (chooser->priv->themes == NULL)
+                return NULL;
+
+        info = g_hash_table_lookup (chooser->priv->themes, id);
+        if (info == NULL || info->chain == NULL)
+                return NULL;
+
+        return info->chain[0];
 }
 
 static void
 set_combox_for_theme_name (GvcSoundThemeChooser *chooser,
                            const char           *name)
 {
-        GtkTreeIter   iter;
-        GtkTreeModel *model;
-        gboolean      found;
+        SoundThemeInfo *info = NULL;
 
         /* If the name is empty, use "freedesktop" */
         if (name == NULL || *name == '\0') {
                 name = "freedesktop";
         }
 
-        model = gtk_combo_box_get_model (GTK_COMBO_BOX (chooser->priv->combo_box));
-
-        if (gtk_tree_model_get_iter_first (model, &iter) == FALSE) {
-                return;
-        }
-
-        do {
-                char *value;
-
-                gtk_tree_model_get (model, &iter, THEME_IDENTIFIER_COL, &value, -1);
-                found = (value != NULL && strcmp (value, name) == 0);
-                g_free (value);
-
-        } while (!found && gtk_tree_model_iter_next (model, &iter));
+        if (chooser->priv->themes != NULL)
+                info = g_hash_table_lookup (chooser->priv->themes, name);
 
         /* When we can't find the theme we need to set, try to set the default
          * one "freedesktop" */
-        if (found) {
+        if (info != NULL && gtk_tree_row_reference_valid (info->row)) {
+                GtkTreeModel *model;
+                GtkTreePath  *path;
+                GtkTreeIter   iter;
+
+                model = gtk_tree_row_reference_get_model (info->row);
+                path = gtk_tree_row_reference_get_path (info->row);
+                gtk_tree_model_get_iter (model, &iter, path);
+                gtk_tree_path_free (path);
+
                 gtk_combo_box_set_active_iter (GTK_COMBO_BOX (chooser->priv->combo_box), &iter);
         } else if (strcmp (name, "freedesktop") != 0) {
                 g_debug ("not found, falling back to fdo");
@@ -271,16 +394,22 @@ static void
 setup_theme_selector (GvcSoundThemeChooser *chooser)
 {
         GHashTable           *hash;
+        GHashTableIter        iter;
+        SoundThemeInfo       *no_sounds;
         GtkListStore         *store;
         GtkCellRenderer      *renderer;
         const char * const   *data_dirs;
         const char           *data_dir;
         char                 *dir;
+        gpointer              key;
+        gpointer              value;
         guint                 i;
 
         /* Add the theme names and their display name to a hash table,
          * makes it easy to avoid duplicate themes */
-        hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+        hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                      g_free,
+                                      (GDestroyNotify) sound_theme_info_free);
 
         data_dirs = g_get_system_data_dirs ();
         for (i = 0; data_dirs[i] != NULL; i++) {
@@ -312,16 +441,20 @@ setup_theme_selector (GvcSoundThemeChooser *chooser)
                                     G_TYPE_STRING,
                                     G_TYPE_STRING);
 
-        /* Add the themes to a combobox */
-        gtk_list_store_insert_with_values (store,
-                                           NULL,
-                                           G_MAXINT,
-                                           THEME_DISPLAY_COL, _("No sounds"),
-                                           THEME_IDENTIFIER_COL, "__no_sounds",
-                                           THEME_PARENT_ID_COL, NULL,
-                                           -1);
-        g_hash_table_foreach (hash, (GHFunc) add_theme_to_store, store);
-        g_hash_table_destroy (hash);
+        /* Add the themes to a combobox, and resolve their parents once
+         * for all so that later lookups do not need to read index files
+         * or walk the model */
+        no_sounds = sound_theme_info_new (g_strdup (_("No sounds")), NULL);
+        add_theme_to_store (chooser, store, NO_SOUNDS_THEME_NAME, no_sounds);
+
+        g_hash_table_iter_init (&iter, hash);
+        while (g_hash_table_iter_next (&iter, &key, &value)) {
+                update_theme_chain (hash, key, value);
+                add_theme_to_store (chooser, store, key, value);
+        }
+
+        g_hash_table_insert (hash, g_strdup (NO_SOUNDS_THEME_NAME), no_sounds);
+        chooser->priv->themes = hash;
 
         /* Set the display */
         gtk_combo_box_set_model (GTK_COMBO_BOX (chooser->priv->combo_box),
@@ -510,31 +643,34 @@ populate_model_from_dir (GvcSoundThemeChooser *chooser,
         g_dir_close (d);
 }
 
-static gboolean
-save_alert_sounds (GvcSoundThemeChooser  *chooser,
-                   const char            *id)
+static void
+save_alert_sounds (GvcSoundThemeChooser   *chooser,
+                   CustomThemeTransaction *transaction,
+                   const char             *id)
 {
         const char *sounds[3] = { "bell-terminal", "bell-window-system", NULL };
-        char *path;
 
-        if (strcmp (id, DEFAULT_ALERT_ID) == 0) {
-                delete_old_files (sounds);
-                delete_disabled_files (sounds);
-        } else {
-                delete_old_files (sounds);
-                delete_disabled_files (sounds);
-                add_custom_file (sounds, id);
-        }
+        custom_theme_transaction_delete_old_files (transaction, sounds);
+        custom_theme_transaction_delete_disabled_files (transaction, sounds);
 
-        /* And poke the directory so the theme gets updated */
-        path = custom_theme_dir_path (NULL);
-        if (utime (path, NULL) != 0) {
-                g_warning ("Failed to update mtime for directory '%s': %s",
-                           path, g_strerror (errno));
+        if (strcmp (id, DEFAULT_ALERT_ID) != 0)
+                custom_theme_transaction_add_custom_file (transaction, sounds, id);
+}
+
+static gboolean
+commit_alert_sounds (CustomThemeTransaction *transaction)
+{
+        GError   *error = NULL;
+        gboolean  success;
+
+        success = custom_theme_transaction_commit (transaction, &error);
+        if (success == FALSE) {
+                g_warning ("Failed to update the custom sound theme: %s", error->message);
+                g_error_free (error);
         }
-        g_free (path);
+        custom_theme_transaction_free (transaction);
 
-        return FALSE;
+        return success;
 }
 
 static void
@@ -568,6 +704,30 @@ update_alert_model (GvcSoundThemeChooser  *chooser,
         } while (gtk_tree_model_iter_next (model, &iter));
 }
 
+static void
+remove_custom_theme_row (GvcSoundThemeChooser *chooser)
+{
+        SoundThemeInfo *info;
+
+        info = g_hash_table_lookup (chooser->priv->themes, CUSTOM_THEME_NAME);
+        if (info == NULL)
+                return;
+
+        if (gtk_tree_row_reference_valid (info->row)) {
+                GtkTreeModel *model;
+                GtkTreePath  *path;
+                GtkTreeIter   iter;
+
+                model = gtk_tree_row_reference_get_model (info->row);
+                path = gtk_tree_row_reference_get_path (info->row);
+                gtk_tree_model_get_iter (model, &iter, path);
+                gtk_tree_path_free (path);
+
+                gtk_list_store_remove (GTK_LIST_STORE (model), &iter);
+        }
+        g_hash_table_remove (chooser->priv->themes, CUSTOM_THEME_NAME);
+}
+
 static void
 update_alert (GvcSoundThemeChooser *chooser,
               const char           *alert_id)
@@ -580,6 +740,7 @@ update_alert (GvcSoundThemeChooser *chooser,
         gboolean      is_default;
         gboolean      add_custom;
         gboolean      remove_custom;
+        CustomThemeTransaction *transaction;
 
         theme_model = gtk_combo_box_get_model (GTK_COMBO_BOX (chooser->priv->combo_box));
         /* Get the current theme's name, and set the parent */
@@ -606,43 +767,45 @@ update_alert (GvcSoundThemeChooser *chooser,
                 /* remove custom just in case */
                 remove_custom = TRUE;
         } else if (! is_custom && ! is_default) {
-                create_custom_theme (parent);
-                save_alert_sounds (chooser, alert_id);
-                add_custom = TRUE;
+                transaction = custom_theme_transaction_begin (parent);
+                if (transaction != NULL) {
+                        save_alert_sounds (chooser, transaction, alert_id);
+                        add_custom = commit_alert_sounds (transaction);
+                }
         } else if (is_custom && is_default) {
-                save_alert_sounds (chooser, alert_id);
-                /* after removing files check if it is empty */
-                if (custom_theme_dir_is_empty ()) {
-                        remove_custom = TRUE;
+                transaction = custom_theme_transaction_begin (NULL);
+                if (transaction != NULL) {
+                        save_alert_sounds (chooser, transaction, alert_id);
+                        /* after removing files check if it is empty, in which
+                         * case there is nothing worth publishing */
+                        if (custom_theme_transaction_is_empty (transaction)) {
+                                custom_theme_transaction_free (transaction);
+                                remove_custom = TRUE;
+                        } else {
+                                commit_alert_sounds (transaction);
+                        }
                 }
         } else if (is_custom && ! is_default) {
-                save_alert_sounds (chooser, alert_id);
+                transaction = custom_theme_transaction_begin (NULL);
+                if (transaction != NULL) {
+                        save_alert_sounds (chooser, transaction, alert_id);
+                        commit_alert_sounds (transaction);
+                }
         }
 
         if (add_custom) {
-                gtk_list_store_insert_with_values (GTK_LIST_STORE (theme_model),
-                                                   NULL,
-                                                   G_MAXINT,
-                                                   THEME_DISPLAY_COL, _("Custom"),
-                                                   THEME_IDENTIFIER_COL, CUSTOM_THEME_NAME,
-                                                   THEME_PARENT_ID_COL, theme,
-                                                   -1);
+                SoundThemeInfo *info;
+
+                remove_custom_theme_row (chooser);
+
+                info = sound_theme_info_new (g_strdup (_("Custom")), g_strdup (theme));
+                g_hash_table_insert (chooser->priv->themes, g_strdup (CUSTOM_THEME_NAME), info);
+                update_theme_chain (chooser->priv->themes, CUSTOM_THEME_NAME, info);
+                add_theme_to_store (chooser, GTK_LIST_STORE (theme_model), CUSTOM_THEME_NAME, info);
+
                 set_combox_for_theme_name (chooser, CUSTOM_THEME_NAME);
         } else if (remove_custom) {
-                gtk_tree_model_get_iter_first (theme_model, &iter);
-                do {
-                        char *this_parent;
-
-                        gtk_tree_model_get (theme_model, &iter,
-                                            THEME_PARENT_ID_COL, &this_parent,
-                                            -1);
-                        if (this_parent != NULL && strcmp (this_parent, CUSTOM_THEME_NAME) != 0) {
-                                g_free (this_parent);
-                                gtk_list_store_remove (GTK_LIST_STORE (theme_model), &iter);
-                                break;
-                        }
-                        g_free (this_parent);
-                } while (gtk_tree_model_iter_next (theme_model, &iter));
+                remove_custom_theme_row (chooser);
 
                 delete_custom_theme_dir ();
 
@@ -686,6 +849,131 @@ on_alert_toggled (GtkCellRendererToggle *renderer,
         g_free (id);
 }
 
+/* Returns the private event id the alert file is cached under in the sound
+ * server, or %NULL if the path is too long to be used as one.
+ *
+ * The alerts are absolute paths that do not depend on the sound theme, so
+ * the id is derived from the path itself: it stays the same across theme
+ * changes and runs and never refers to another file, and caching the file
+ * again just replaces the sample. */
+static gchar *
+preview_event_id (const gchar *filename)
+{
+        if (strlen (PREVIEW_EVENT_ID_PREFIX) + strlen (filename) > PREVIEW_EVENT_ID_MAX)
+                return NULL;
+
+        return g_strconcat (PREVIEW_EVENT_ID_PREFIX, filename, NULL);
+}
+
+typedef struct
+{
+        GPtrArray  *event_ids;
+        GPtrArray  *filenames;
+} PreviewCacheData;
+
+static void
+preview_cache_data_free (PreviewCacheData *data)
+{
+        g_ptr_array_unref (data->event_ids);
+        g_ptr_array_unref (data->filenames);
+        g_free (data);
+}
+
+static void
+preview_cache_thread (GTask        *task,
+                      gpointer      source_object,
+                      gpointer      task_data,
+                      GCancellable *cancellable)
+{
+        PreviewCacheData *data = task_data;
+        ca_context       *context;
+        guint             i;
+
+        /* Use a private connection, libcanberra holds the lock of a context
+         * for the whole upload and the shared context of the screen would
+         * stall the previews played from the main thread */
+        if (ca_context_create (&context) != CA_SUCCESS) {
+                g_task_return_boolean (task, FALSE);
+                return;
+        }
+
+        ca_context_change_props (context,
+                                 CA_PROP_APPLICATION_NAME, _("Sound Preferences"),
+                                 CA_PROP_APPLICATION_ID, "org.mate.VolumeControl",
+                                 NULL);
+
+        for (i = 0; i < data->filenames->len; i++) {
+                int res;
+
+                if (g_cancellable_is_cancelled (cancellable))
+                        break;
+
+                /* This decodes the file and waits for the upload to finish */
+                res = ca_context_cache (context,
+                                        CA_PROP_EVENT_ID, g_ptr_array_index (data->event_ids, i),
+                                        CA_PROP_MEDIA_FILENAME, g_ptr_array_index (data->filenames, i),
+                                        CA_PROP_CANBERRA_CACHE_CONTROL, "volatile",
+                                        NULL);
+                if (res == CA_ERROR_NOTSUPPORTED)
+                        break;
+                if (res != CA_SUCCESS)
+                        g_debug ("Failed to cache '%s': %s",
+                                 (const char *) g_ptr_array_index (data->filenames, i),
+                                 ca_strerror (res));
+        }
+
+        ca_context_destroy (context);
+
+        g_task_return_boolean (task, TRUE);
+}
+
+/* Uploads the alert files to the sound server once, the list of alerts
+ * does not change afterwards */
+static void
+preload_alert_previews (GvcSoundThemeChooser *chooser)
+{
+        GtkTreeModel     *model;
+        GtkTreeIter       iter;
+        GTask            *task;
+        PreviewCacheData *data;
+
+        model = gtk_tree_view_get_model (GTK_TREE_VIEW (chooser->priv->treeview));
+        if (gtk_tree_model_get_iter_first (model, &iter) == FALSE)
+                return;
+
+        data = g_new0 (PreviewCacheData, 1);
+        data->event_ids = g_ptr_array_new_with_free_func (g_free);
+        data->filenames = g_ptr_array_new_with_free_func (g_free);
+
+        do {
+                char *id;
+                char *event_id;
+
+                gtk_tree_model_get (model, &iter, ALERT_IDENTIFIER_COL, &id, -1);
+
+                /* The default alert depends on the theme and is not cached */
+                if (id == NULL || strcmp (id, DEFAULT_ALERT_ID) == 0) {
+                        g_free (id);
+                        continue;
+                }
+
+                event_id = preview_event_id (id);
+                if (event_id == NULL) {
+                        g_free (id);
+                        continue;
+                }
+                g_ptr_array_add (data->event_ids, event_id);
+                g_ptr_array_add (data->filenames, id);
+        } while (gtk_tree_model_iter_next (model, &iter));
+
+        chooser->priv->preview_cancellable = g_cancellable_new ();
+
+        task = g_task_new (NULL, chooser->priv->preview_cancellable, NULL, NULL);
+        g_task_set_task_data (task, data, (GDestroyNotify) preview_cache_data_free);
+        g_task_run_in_thread (task, preview_cache_thread);
+        g_object_unref (task);
+}
+
 static void
 play_preview_for_path (GvcSoundThemeChooser *chooser, GtkTreePath *path)
 {
@@ -708,18 +996,15 @@ play_preview_for_path (GvcSoundThemeChooser *chooser, GtkTreePath *path)
         if (gtk_combo_box_get_active_iter (GTK_COMBO_BOX (chooser->priv->combo_box), &theme_iter)) {
                 GtkTreeModel *theme_model;
                 gchar        *theme_id = NULL;
-                gchar        *parent_id = NULL;
 
                 theme_model = gtk_combo_box_get_model (GTK_COMBO_BOX (chooser->priv->combo_box));
 
                 gtk_tree_model_get (theme_model, &theme_iter,
-                                    THEME_IDENTIFIER_COL, &theme_id,
-                                    THEME_PARENT_ID_COL, &parent_id, -1);
+                                    THEME_IDENTIFIER_COL, &theme_id, -1);
                 if (theme_id && strcmp (theme_id, CUSTOM_THEME_NAME) == 0)
-                        parent_theme = g_strdup (parent_id);
+                        parent_theme = g_strdup (get_theme_parent (chooser, theme_id));
 
                 g_free (theme_id);
-                g_free (parent_id);
         }
 
         /* special case: for the default item on custom themes
@@ -750,17 +1035,26 @@ play_preview_for_path (GvcSoundThemeChooser *chooser, GtkTreePath *path)
                                                 NULL);
                 }
         } else {
+                gchar *event_id;
+
+                /* The alert files are cached in the sound server under
+                 * a private event id, so only the first preview needs
+                 * to decode and upload them */
+                event_id = preview_event_id (id);
                 ca_gtk_play_for_widget (GTK_WIDGET (chooser), 0,
                                         CA_PROP_APPLICATION_NAME, _("Sound Preferences"),
                                         CA_PROP_MEDIA_FILENAME, id,
                                         CA_PROP_EVENT_DESCRIPTION, _("Testing event sound"),
-                                        CA_PROP_CANBERRA_CACHE_CONTROL, "never",
+                                        CA_PROP_CANBERRA_CACHE_CONTROL, (event_id != NULL) ? "volatile" : "never",
                                         CA_PROP_APPLICATION_ID, "org.mate.VolumeControl",
 #ifdef CA_PROP_CANBERRA_ENABLE
                                         CA_PROP_CANBERRA_ENABLE, "1",
 #endif
+                                        /* Ends the list here when the file has
+                                         * no cache id */
+                                        (event_id != NULL) ? CA_PROP_EVENT_ID : NULL, event_id,
                                         NULL);
-
+                g_free (event_id);
         }
         g_free (parent_theme);
         g_free (id);
@@ -799,6 +1093,127 @@ on_treeview_selection_changed (GtkTreeSelection     *selection,
         g_list_free (paths);
 }
 
+/* Only what the worker thread touches, the row reference is passed to the
+ * callback and freed there, GTask may free its data in the worker thread */
+typedef struct
+{
+        char                *filename;
+        guint                channels;
+        guint                rate;
+        guint64              duration_ms;
+} AlertProbeData;
+
+static void
+alert_probe_data_free (AlertProbeData *data)
+{
+        g_free (data->filename);
+        g_free (data);
+}
+
+static void
+alert_probe_thread (GTask        *task,
+                    gpointer      source_object,
+                    gpointer      task_data,
+                    GCancellable *cancellable)
+{
+        AlertProbeData *data = task_data;
+
+        if (g_cancellable_is_cancelled (cancellable) == FALSE &&
+            sound_file_probe_header (data->filename,
+                                     &data->channels,
+                                     &data->rate,
+                                     &data->duration_ms))
+                g_task_return_boolean (task, TRUE);
+        else
+                g_task_return_boolean (task, FALSE);
+}
+
+static void
+on_alert_probe_done (GObject      *source_object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+        GtkTreeRowReference *row = user_data;
+        AlertProbeData      *data;
+        GtkTreeModel        *model;
+        GtkTreePath         *path;
+        GtkTreeIter          iter;
+        char                *duration;
+        char                *channels;
+        char                *rate;
+
+        if (g_task_propagate_boolean (G_TASK (result), NULL) == FALSE ||
+            g_cancellable_is_cancelled (g_task_get_cancellable (G_TASK (result))) ||
+            gtk_tree_row_reference_valid (row) == FALSE) {
+                gtk_tree_row_reference_free (row);
+                return;
+        }
+
+        data = g_task_get_task_data (G_TASK (result));
+
+        model = gtk_tree_row_reference_get_model (row);
+        path = gtk_tree_row_reference_get_path (row);
+        gtk_tree_model_get_iter (model, &iter, path);
+        gtk_tree_path_free (path);
+
+        /* Translators: duration of an alert sound in seconds */
+        duration = g_strdup_printf (_("%.1f s"), data->duration_ms / 1000.0);
+        channels = g_strdup_printf (ngettext ("%u channel", "%u channels", data->channels),
+                                    data->channels);
+        /* Translators: sample rate of an alert sound */
+        rate = g_strdup_printf (_("%u Hz"), data->rate);
+
+        gtk_list_store_set (GTK_LIST_STORE (model), &iter,
+                            ALERT_DURATION_COL, duration,
+                            ALERT_CHANNELS_COL, channels,
+                            ALERT_RATE_COL, rate,
+                            -1);
+        g_free (duration);
+        g_free (channels);
+        g_free (rate);
+
+        gtk_tree_row_reference_free (row);
+}
+
+/* Reads the stream parameters of every alert file in the thread pool,
+ * filling in the rows as the results come in */
+static void
+probe_alert_files (GvcSoundThemeChooser *chooser, GtkTreeModel *model)
+{
+        GtkTreeIter iter;
+
+        if (gtk_tree_model_get_iter_first (model, &iter) == FALSE)
+                return;
+
+        chooser->priv->probe_cancellable = g_cancellable_new ();
+
+        do {
+                AlertProbeData      *data;
+                GtkTreeRowReference *row;
+                GtkTreePath         *path;
+                GTask               *task;
+                char                *id;
+
+                gtk_tree_model_get (model, &iter, ALERT_IDENTIFIER_COL, &id, -1);
+                if (id == NULL || strcmp (id, DEFAULT_ALERT_ID) == 0) {
+                        g_free (id);
+                        continue;
+                }
+
+                data = g_new0 (AlertProbeData, 1);
+                data->filename = id;
+
+                path = gtk_tree_model_get_path (model, &iter);
+                row = gtk_tree_row_reference_new (model, path);
+                gtk_tree_path_free (path);
+
+                task = g_task_new (NULL, chooser->priv->probe_cancellable, on_alert_probe_done, row);
+                g_task_set_task_data (task, data, (GDestroyNotify) alert_probe_data_free);
+                g_task_run_in_thread (task, alert_probe_thread);
+                g_object_unref (task);
+        } while (gtk_tree_model_iter_next (model, &iter));
+}
+
 static GtkWidget *
 create_alert_treeview (GvcSoundThemeChooser *chooser)
 {
@@ -824,16 +1239,21 @@ create_alert_treeview (GvcSoundThemeChooser *chooser)
                           G_CALLBACK (on_treeview_selection_changed),
                           chooser);
 
-        /* Setup the tree model, 3 columns:
+        /* Setup the tree model, 7 columns:
          * - display name
          * - sound id
          * - sound type
+         * - whether the sound is selected
+         * - duration, channels and sample rate, probed from the file
          */
         store = gtk_list_store_new (ALERT_NUM_COLS,
                                     G_TYPE_STRING,
                                     G_TYPE_STRING,
                                     G_TYPE_STRING,
-                                    G_TYPE_BOOLEAN);
+                                    G_TYPE_BOOLEAN,
+                                    G_TYPE_STRING,
+                                    G_TYPE_STRING,
+                                    G_TYPE_STRING);
 
         gtk_list_store_insert_with_values (store,
                                            NULL,
@@ -877,6 +1297,29 @@ create_alert_treeview (GvcSoundThemeChooser *chooser)
 
         gtk_tree_view_append_column (GTK_TREE_VIEW (treeview), column);
 
+        renderer = gtk_cell_renderer_text_new ();
+        column = gtk_tree_view_column_new_with_attributes (_("Duration"),
+                                                           renderer,
+                                                           "text", ALERT_DURATION_COL,
+                                                           NULL);
+        gtk_tree_view_append_column (GTK_TREE_VIEW (treeview), column);
+
+        renderer = gtk_cell_renderer_text_new ();
+        column = gtk_tree_view_column_new_with_attributes (_("Channels"),
+                                                           renderer,
+                                                           "text", ALERT_CHANNELS_COL,
+                                                           NULL);
+        gtk_tree_view_append_column (GTK_TREE_VIEW (treeview), column);
+
+        renderer = gtk_cell_renderer_text_new ();
+        column = gtk_tree_view_column_new_with_attributes (_("Sample Rate"),
+                                                           renderer,
+                                                           "text", ALERT_RATE_COL,
+                                                           NULL);
+        gtk_tree_view_append_column (GTK_TREE_VIEW (treeview), column);
+
+        probe_alert_files (chooser, GTK_TREE_MODEL (store));
+
         return treeview;
 }
 
@@ -914,6 +1357,40 @@ get_file_type (const char *sound_name,
         return SOUND_TYPE_BUILTIN;
 }
 
+/* Adds a row for a custom alert which is not one of the installed ones,
+ * such as a sound imported with a theme archive */
+static void
+ensure_alert_row (GvcSoundThemeChooser *chooser, const char *filename)
+{
+        GtkTreeModel *model;
+        GtkTreeIter   iter;
+
+        model = gtk_tree_view_get_model (GTK_TREE_VIEW (chooser->priv->treeview));
+
+        if (gtk_tree_model_get_iter_first (model, &iter)) {
+                do {
+                        char     *id;
+                        gboolean  found;
+
+                        gtk_tree_model_get (model, &iter, ALERT_IDENTIFIER_COL, &id, -1);
+                        found = g_strcmp0 (id, filename) == 0;
+                        g_free (id);
+
+                        if (found)
+                                return;
+                } while (gtk_tree_model_iter_next (model, &iter));
+        }
+
+        gtk_list_store_insert_with_values (GTK_LIST_STORE (model),
+                                           NULL,
+                                           G_MAXINT,
+                                           ALERT_IDENTIFIER_COL, filename,
+                                           ALERT_DISPLAY_COL, _("Imported"),
+                                           ALERT_SOUND_TYPE_COL, _("Custom"),
+                                           ALERT_ACTIVE_COL, FALSE,
+                                           -1);
+}
+
 static void
 update_alerts_from_theme_name (GvcSoundThemeChooser *chooser,
                                const gchar          *name)
@@ -929,6 +1406,7 @@ update_alerts_from_theme_name (GvcSoundThemeChooser *chooser,
                 sound_type = get_file_type ("bell-terminal", &linkname);
                 g_debug ("Found link: %s", linkname);
                 if (sound_type == SOUND_TYPE_CUSTOM) {
+                        ensure_alert_row (chooser, linkname);
                         update_alert (chooser, linkname);
                 }
         }
@@ -1085,6 +1563,8 @@ gvc_sound_theme_chooser_init (GvcSoundThemeChooser *chooser)
         update_theme (chooser);
 
         setup_list_size_constraint (scrolled_window, chooser->priv->treeview);
+
+        preload_alert_previews (chooser);
 }
 
 static void
@@ -1095,6 +1575,16 @@ gvc_sound_theme_chooser_dispose (GObject *object)
         chooser = GVC_SOUND_THEME_CHOOSER (object);
 
         g_clear_object (&chooser->priv->sound_settings);
+        g_clear_pointer (&chooser->priv->themes, g_hash_table_destroy);
+
+        if (chooser->priv->preview_cancellable != NULL) {
+                g_cancellable_cancel (chooser->priv->preview_cancellable);
+                g_clear_object (&chooser->priv->preview_cancellable);
+        }
+        if (chooser->priv->probe_cancellable != NULL) {
+                g_cancellable_cancel (chooser->priv->probe_cancellable);
+                g_clear_object (&chooser->priv->probe_cancellable);
+        }
 
         G_OBJECT_CLASS (gvc_sound_theme_chooser_parent_class)->dispose (object);
 }
@@ -22,6 +22,8 @@
 
 #include "config.h"
 
+#include <math.h>
+
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <glib-object.h>
@@ -31,15 +33,84 @@
 #include <libmatemixer/matemixer.h>
 
 #include "gvc-speaker-test.h"
+#include "gvc-test-signal.h"
 #include "gvc-utils.h"
 
+#define LFE_TEST_FREQUENCY      60.0
+
+/* The longest delay looked for by the delay estimate */
+#define LATENCY_MAX_MS          1000
+#define LATENCY_MIN_CORRELATION 0.3
+
 struct _GvcSpeakerTestPrivate
 {
-        GArray           *controls;
-        ca_context       *canberra;
-        MateMixerStream  *stream;
+        GArray                     *controls;
+        ca_context                 *canberra;
+        MateMixerStream            *stream;
+        GArray                     *steps;
+        guint                       step;
+        guint                       step_serial;
+        guint                       serial;
+        gboolean                    disposed;
+        struct _CompletionChannel  *channel;
+        struct _LatencyMeasurement *measurement;
 };
 
+/* Carries the completions of the played sounds from the libcanberra
+ * thread to the main thread, all the pending completions are handled
+ * in a single dispatch of one source */
+typedef struct _CompletionChannel {
+        gint            ref_count;
+        GMutex          lock;
+        GArray         *pending;
+        GSource        *source;
+        GvcSpeakerTest *test;
+} CompletionChannel;
+
+/* Passed to libcanberra for each played sound */
+typedef struct {
+        CompletionChannel *channel;
+        GtkWidget         *control;
+        guint              serial;
+} CompletionHandle;
+
+typedef struct {
+        GtkWidget *control;
+        guint      serial;
+        int        error_code;
+} Completion;
+
+/* One position of the "test all" walk */
+typedef struct {
+        GtkWidget   *control;
+        ca_proplist *proplist;
+} SpeakerTestStep;
+
+/* Checks whether a burst played on each position is picked up by the peak
+ * level monitor of an input, a rough loopback check.
+ *
+ * The monitor only reports peak levels, so the burst can only be located by
+ * its onset, and the delay found includes the unknown delivery and update
+ * delay of the monitor. It tells a speaker that is heard late from one that
+ * is heard at all, it is not the output to input round trip. */
+typedef struct _LatencyMeasurement {
+        GvcSpeakerTest         *test;
+        MateMixerStreamControl *input;
+        gboolean                monitor_was_enabled;
+        GArray                 *controls;
+        guint                   step;
+        gint64                  start_time;
+        GArray                 *times;
+        GArray                 *values;
+        guint                   timeout_id;
+        GCancellable           *cancellable;
+} LatencyMeasurement;
+
+typedef struct {
+        GArray *times;
+        GArray *values;
+} LatencyCapture;
+
 enum {
         PROP_0,
         PROP_STREAM,
@@ -257,42 +328,268 @@ update_button (GtkWidget *control)
                                       GTK_ICON_SIZE_DIALOG);
 }
 
+static void
+set_control_playing (GtkWidget *control, gboolean playing)
+{
+        g_object_set_data (G_OBJECT (control), "playing", GINT_TO_POINTER (playing));
+
+        update_button (control);
+}
+
+static void completion_finished (GvcSpeakerTest *test, Completion *completion);
+
 static gboolean
-idle_cb (GtkWidget *control)
+completion_source_dispatch (GSource     *source,
+                            GSourceFunc  callback,
+                            gpointer     user_data)
 {
-        if (control != NULL) {
-                /* This is called in the background thread, hence forward to main thread
-                 * via idle callback */
-                g_object_set_data (G_OBJECT (control), "playing", GINT_TO_POINTER (FALSE));
+        g_source_set_ready_time (source, -1);
 
-                update_button (control);
-        }
-        return FALSE;
+        return callback (user_data);
+}
+
+static GSourceFuncs completion_source_funcs = {
+        NULL,
+        NULL,
+        completion_source_dispatch,
+        NULL
+};
+
+static CompletionChannel *
+completion_channel_ref (CompletionChannel *channel)
+{
+        g_atomic_int_inc (&channel->ref_count);
+
+        return channel;
+}
+
+static void
+completion_channel_unref (CompletionChannel *channel)
+{
+        if (g_atomic_int_dec_and_test (&channel->ref_count) == FALSE)
+                return;
+
+        g_source_unref (channel->source);
+        g_array_unref (channel->pending);
+        g_mutex_clear (&channel->lock);
+        g_free (channel);
+}
+
+static gboolean
+completion_channel_drain (CompletionChannel *channel)
+{
+        GArray *pending;
+        guint   i;
+
+        g_mutex_lock (&channel->lock);
+        pending = channel->pending;
+        channel->pending = g_array_new (FALSE, FALSE, sizeof (Completion));
+        g_mutex_unlock (&channel->lock);
+
+        /* The test is only cleared on the main thread */
+        for (i = 0; i < pending->len && channel->test != NULL; i++)
+                completion_finished (channel->test, &g_array_index (pending, Completion, i));
+
+        g_array_unref (pending);
+
+        return G_SOURCE_CONTINUE;
+}
+
+static CompletionChannel *
+completion_channel_new (GvcSpeakerTest *test)
+{
+        CompletionChannel *channel;
+
+        channel = g_new0 (CompletionChannel, 1);
+        channel->ref_count = 1;
+        channel->pending = g_array_new (FALSE, FALSE, sizeof (Completion));
+        channel->test = test;
+
+        g_mutex_init (&channel->lock);
+
+        channel->source = g_source_new (&completion_source_funcs, sizeof (GSource));
+        g_source_set_priority (channel->source, G_PRIORITY_HIGH_IDLE);
+        g_source_set_callback (channel->source,
+                               (GSourceFunc) completion_channel_drain,
+                               completion_channel_ref (channel),
+                               (GDestroyNotify) completion_channel_unref);
+        g_source_attach (channel->source, NULL);
+
+        return channel;
+}
+
+/* Called from dispose, no completion is handled afterwards */
+static void
+completion_channel_close (CompletionChannel *channel)
+{
+        g_mutex_lock (&channel->lock);
+        channel->test = NULL;
+        g_mutex_unlock (&channel->lock);
+
+        g_source_destroy (channel->source);
+        completion_channel_unref (channel);
+}
+
+static CompletionHandle *
+completion_handle_new (GvcSpeakerTest *test, GtkWidget *control)
+{
+        CompletionHandle *handle;
+
+        handle = g_new (CompletionHandle, 1);
+        handle->channel = completion_channel_ref (test->priv->channel);
+        handle->control = control;
+        handle->serial  = ++test->priv->serial;
+
+        return handle;
+}
+
+static void
+completion_handle_free (CompletionHandle *handle)
+{
+        completion_channel_unref (handle->channel);
+        g_free (handle);
 }
 
 static void
 finish_cb (ca_context *c, uint32_t id, int error_code, void *userdata)
 {
-        GtkWidget *control = (GtkWidget *) userdata;
+        CompletionHandle  *handle = userdata;
+        CompletionChannel *channel = handle->channel;
 
-        if (error_code == CA_ERROR_DESTROYED || control == NULL)
-                return;
+        /* This is called in the background thread, the completion is
+         * queued and the main thread woken up unless it is already */
+        g_mutex_lock (&channel->lock);
+
+        if (channel->test != NULL) {
+                Completion completion;
+
+                completion.control    = handle->control;
+                completion.serial     = handle->serial;
+                completion.error_code = error_code;
+
+                g_array_append_val (channel->pending, completion);
+
+                if (channel->pending->len == 1)
+                        g_source_set_ready_time (channel->source, 0);
+        }
+        g_mutex_unlock (&channel->lock);
+
+        completion_handle_free (handle);
+}
+
+/* Starts playing a sound for the control, returns the serial of the
+ * sound or 0 if it cannot be played */
+static guint
+play_for_control (GvcSpeakerTest *test,
+                  GtkWidget      *control,
+                  ca_proplist    *proplist)
+{
+        CompletionHandle *handle;
+        guint             serial;
+
+        handle = completion_handle_new (test, control);
+        serial = handle->serial;
+
+        if (ca_context_play_full (test->priv->canberra, 1,
+                                  proplist,
+                                  finish_cb,
+                                  handle) < 0) {
+                completion_handle_free (handle);
+                return 0;
+        }
+
+        g_object_set_data (G_OBJECT (control), "serial", GUINT_TO_POINTER (serial));
+
+        return serial;
+}
+
+static ca_proplist *
+create_proplist (MateMixerChannelPosition position)
+{
+        ca_proplist *proplist;
+
+        ca_proplist_create (&proplist);
+        ca_proplist_sets (proplist,
+                          CA_PROP_MEDIA_ROLE, "test");
+        ca_proplist_sets (proplist,
+                          CA_PROP_MEDIA_NAME,
+                          gvc_channel_position_to_pretty_string (position));
+        ca_proplist_sets (proplist,
+                          CA_PROP_CANBERRA_FORCE_CHANNEL,
+                          gvc_channel_position_to_pulse_string (position));
+
+        ca_proplist_sets (proplist, CA_PROP_CANBERRA_ENABLE, "1");
+
+        return proplist;
+}
+
+/* Properties to play a signal generated by us rather than one from the
+ * sound theme, this avoids the theme lookup and sounds the same on every
+ * system */
+static ca_proplist *
+create_test_signal_proplist (MateMixerChannelPosition position)
+{
+        ca_proplist *proplist;
+        const gchar *path;
+        GError      *error = NULL;
+
+        if (position == MATE_MIXER_CHANNEL_LFE)
+                path = gvc_test_signal_get_file (GVC_TEST_SIGNAL_SINE, LFE_TEST_FREQUENCY, &error);
+        else
+                path = gvc_test_signal_get_file (GVC_TEST_SIGNAL_PINK_NOISE, 0.0, &error);
+
+        if (path == NULL) {
+                g_warning ("Failed to generate the test signal: %s", error->message);
+                g_error_free (error);
+                return NULL;
+        }
+
+        proplist = create_proplist (position);
+        ca_proplist_sets (proplist, CA_PROP_MEDIA_FILENAME, path);
+
+        return proplist;
+}
+
+static gboolean
+play_test_signal (GvcSpeakerTest           *test,
+                  MateMixerChannelPosition  position,
+                  GtkWidget                *control)
+{
+        ca_proplist *proplist;
+        gboolean     playing;
+
+        proplist = create_test_signal_proplist (position);
+        if (proplist == NULL)
+                return FALSE;
+
+        playing = play_for_control (test, control, proplist) != 0;
 
-        g_idle_add ((GSourceFunc) idle_cb, control);
+        ca_proplist_destroy (proplist);
+
+        return playing;
 }
 
+static void stop_walk (GvcSpeakerTest *test);
+static void stop_measurement (GvcSpeakerTest *test);
+
 static void
 on_test_button_clicked (GtkButton *button, GtkWidget *control)
 {
-        gboolean    playing;
-        ca_context *canberra;
-
-        canberra = g_object_get_data (G_OBJECT (control), "canberra");
+        gboolean        playing;
+        GvcSpeakerTest *test;
 
-        ca_context_cancel (canberra, 1);
+        test = GVC_SPEAKER_TEST (gtk_widget_get_ancestor (control, GVC_TYPE_SPEAKER_TEST));
+        if (G_UNLIKELY (test == NULL))
+                return;
 
         playing = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (control), "playing"));
 
+        /* A click on any position ends the test of all positions */
+        stop_walk (test);
+        stop_measurement (test);
+
+        ca_context_cancel (test->priv->canberra, 1);
+
         if (playing) {
                 g_object_set_data (G_OBJECT (control), "playing", GINT_TO_POINTER (FALSE));
         } else {
@@ -302,48 +599,556 @@ on_test_button_clicked (GtkButton *button, GtkWidget *control)
 
                 position = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (control), "position"));
 
-                ca_proplist_create (&proplist);
-                ca_proplist_sets (proplist,
-                                  CA_PROP_MEDIA_ROLE, "test");
-                ca_proplist_sets (proplist,
-                                  CA_PROP_MEDIA_NAME,
-                                  gvc_channel_position_to_pretty_string (position));
-                ca_proplist_sets (proplist,
-                                  CA_PROP_CANBERRA_FORCE_CHANNEL,
-                                  gvc_channel_position_to_pulse_string (position));
+                playing = play_test_signal (test, position, control);
 
-                ca_proplist_sets (proplist, CA_PROP_CANBERRA_ENABLE, "1");
+                /* Fall back to the sounds of the theme */
+                proplist = create_proplist (position);
 
                 name = sound_name (position);
-                if (name != NULL) {
+                if (!playing && name != NULL) {
                         ca_proplist_sets (proplist, CA_PROP_EVENT_ID, name);
-                        playing = ca_context_play_full (canberra, 1, proplist, finish_cb, control) >= 0;
+                        playing = play_for_control (test, control, proplist) != 0;
                 }
 
                 if (!playing) {
                         ca_proplist_sets (proplist, CA_PROP_EVENT_ID, "audio-test-signal");
-                        playing = ca_context_play_full (canberra, 1, proplist, finish_cb, control) >= 0;
+                        playing = play_for_control (test, control, proplist) != 0;
                 }
 
                 if (!playing) {
                         ca_proplist_sets(proplist, CA_PROP_EVENT_ID, "bell-window-system");
-                        playing = ca_context_play_full (canberra, 1, proplist, finish_cb, control) >= 0;
+                        playing = play_for_control (test, control, proplist) != 0;
                 }
 
+                ca_proplist_destroy (proplist);
+
                 g_object_set_data (G_OBJECT (control), "playing", GINT_TO_POINTER (playing));
         }
 
         update_button (control);
 }
 
+static void
+clear_steps (GvcSpeakerTest *test)
+{
+        guint i;
+
+        for (i = 0; i < test->priv->steps->len; i++) {
+                SpeakerTestStep *step = &g_array_index (test->priv->steps, SpeakerTestStep, i);
+
+                ca_proplist_destroy (step->proplist);
+        }
+        g_array_set_size (test->priv->steps, 0);
+        test->priv->step = 0;
+}
+
+/* Stops the walk, any step still to be reported becomes stale */
+static void
+stop_walk (GvcSpeakerTest *test)
+{
+        if (test->priv->steps->len == 0)
+                return;
+
+        test->priv->step_serial = 0;
+
+        if (test->priv->step < test->priv->steps->len) {
+                SpeakerTestStep *step;
+
+                step = &g_array_index (test->priv->steps, SpeakerTestStep, test->priv->step);
+                set_control_playing (step->control, FALSE);
+        }
+        clear_steps (test);
+}
+
+static void play_step (GvcSpeakerTest *test);
+
+static void
+completion_finished (GvcSpeakerTest *test, Completion *completion)
+{
+        guint serial;
+
+        if (completion->serial == test->priv->step_serial) {
+                SpeakerTestStep *step;
+
+                step = &g_array_index (test->priv->steps, SpeakerTestStep, test->priv->step);
+                set_control_playing (step->control, FALSE);
+
+                test->priv->step_serial = 0;
+
+                if (completion->error_code != CA_SUCCESS) {
+                        clear_steps (test);
+                        return;
+                }
+
+                test->priv->step++;
+                play_step (test);
+                return;
+        }
+
+        /* Ignore the sounds which were replaced by a later one */
+        serial = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (completion->control), "serial"));
+        if (completion->serial == serial)
+                set_control_playing (completion->control, FALSE);
+}
+
+static void
+play_step (GvcSpeakerTest *test)
+{
+        while (test->priv->step < test->priv->steps->len) {
+                SpeakerTestStep *step;
+
+                step = &g_array_index (test->priv->steps, SpeakerTestStep, test->priv->step);
+
+                test->priv->step_serial = play_for_control (test, step->control, step->proplist);
+                if (test->priv->step_serial != 0) {
+                        set_control_playing (step->control, TRUE);
+                        return;
+                }
+
+                /* Skip the positions which cannot be played */
+                test->priv->step++;
+        }
+
+        clear_steps (test);
+}
+
+/**
+ * gvc_speaker_test_play_all:
+ * @test: a #GvcSpeakerTest
+ *
+ * Tests all the speaker positions of the stream one after the other.
+ * The properties of every step are prepared before the first one
+ * starts, so each position follows the previous one right away.
+ */
+void
+gvc_speaker_test_play_all (GvcSpeakerTest *test)
+{
+        guint i;
+
+        g_return_if_fail (GVC_IS_SPEAKER_TEST (test));
+
+        stop_walk (test);
+        stop_measurement (test);
+
+        ca_context_cancel (test->priv->canberra, 1);
+
+        for (i = 0; i < test->priv->controls->len; i++) {
+                GtkWidget                *control;
+                SpeakerTestStep           step;
+                MateMixerChannelPosition  position;
+
+                control = g_array_index (test->priv->controls, GtkWidget *, i);
+
+                /* Stop the single tests */
+                if (GPOINTER_TO_INT (g_object_get_data (G_OBJECT (control), "playing")))
+                        set_control_playing (control, FALSE);
+
+                if (gtk_widget_get_visible (control) == FALSE)
+                        continue;
+
+                position = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (control), "position"));
+
+                step.control = control;
+                step.proplist = create_test_signal_proplist (position);
+                if (step.proplist == NULL)
+                        continue;
+
+                g_array_append_val (test->priv->steps, step);
+        }
+
+        play_step (test);
+}
+
+static void
+set_control_latency (GtkWidget *control, const gchar *text)
+{
+        GtkWidget *label;
+
+        label = g_object_get_data (G_OBJECT (control), "latency-label");
+
+        gtk_label_set_text (GTK_LABEL (label), text);
+        gtk_widget_set_visible (label, text != NULL);
+}
+
+static void
+latency_capture_free (LatencyCapture *capture)
+{
+        g_array_unref (capture->times);
+        g_array_unref (capture->values);
+        g_free (capture);
+}
+
+/* Returns the peak of the test signal in each millisecond of @length.
+ *
+ * The sweep has a constant amplitude, the envelope is a flat burst and the
+ * correlation with it only locates the onset of the burst, which is still
+ * more robust against noise than a fixed threshold */
+static gfloat *
+reference_envelope (guint length)
+{
+        gfloat *samples;
+        gfloat *envelope;
+        guint   per_ms = GVC_TEST_SIGNAL_RATE / 1000;
+        guint   n_samples = GVC_TEST_SIGNAL_RATE * GVC_TEST_SIGNAL_DURATION_MS / 1000;
+        guint   i, j;
+
+        samples = g_new (gfloat, n_samples);
+        gvc_test_signal_generate (GVC_TEST_SIGNAL_SWEEP, 0.0, samples, n_samples);
+
+        envelope = g_new0 (gfloat, length);
+        for (i = 0; i < GVC_TEST_SIGNAL_DURATION_MS && i < length; i++) {
+                gfloat peak = 0.0f;
+
+                for (j = 0; j < per_ms; j++)
+                        peak = MAX (peak, fabsf (samples[i * per_ms + j]));
+
+                envelope[i] = peak;
+        }
+        g_free (samples);
+
+        return envelope;
+}
+
+/* Holds each monitor value until the next one, on a millisecond grid
+ * starting when the test signal was started */
+static gfloat *
+captured_envelope (LatencyCapture *capture, guint length)
+{
+        gfloat *envelope;
+        gfloat  value = 0.0f;
+        guint   i, k = 0;
+
+        envelope = g_new0 (gfloat, length);
+        for (i = 0; i < length; i++) {
+                while (k < capture->times->len &&
+                       g_array_index (capture->times, gint64, k) <= (gint64) i * 1000) {
+                        value = g_array_index (capture->values, gfloat, k);
+                        k++;
+                }
+                envelope[i] = value;
+        }
+        return envelope;
+}
+
+static void
+remove_mean (gfloat *data, guint length)
+{
+        gdouble sum = 0.0;
+        gfloat  mean;
+        guint   i;
+
+        for (i = 0; i < length; i++)
+                sum += data[i];
+
+        mean = (gfloat) (sum / length);
+        for (i = 0; i < length; i++)
+                data[i] -= mean;
+}
+
+static void
+latency_thread (GTask        *task,
+                gpointer      source_object,
+                gpointer      task_data,
+                GCancellable *cancellable)
+{
+        LatencyCapture *capture = task_data;
+        gfloat         *reference;
+        gfloat         *captured;
+        gdouble         reference_energy = 0.0;
+        gdouble         captured_energy = 0.0;
+        gdouble         best = 0.0;
+        gint            best_lag = -1;
+        guint           length = GVC_TEST_SIGNAL_DURATION_MS + LATENCY_MAX_MS;
+        guint           lag, i;
+
+        reference = reference_envelope (length);
+        captured = captured_envelope (capture, length);
+
+        remove_mean (reference, length);
+        remove_mean (captured, length);
+
+        for (i = 0; i < length; i++) {
+                reference_energy += reference[i] * reference[i];
+                captured_energy += captured[i] * captured[i];
+        }
+
+        for (lag = 0; lag <= LATENCY_MAX_MS; lag++) {
+                gdouble sum = 0.0;
+
+                if (g_cancellable_is_cancelled (cancellable))
+                        break;
+
+                for (i = 0; i + lag < length; i++)
+                        sum += reference[i] * captured[i + lag];
+
+                if (sum > best) {
+                        best = sum;
+                        best_lag = lag;
+                }
+        }
+        g_free (reference);
+        g_free (captured);
+
+        /* Nothing that looks like the test signal was captured */
+        if (reference_energy <= 0.0 || captured_energy <= 0.0 ||
+            best / sqrt (reference_energy * captured_energy) < LATENCY_MIN_CORRELATION)
+                best_lag = -1;
+
+        g_task_return_int (task, best_lag);
+}
+
+static void measure_step (LatencyMeasurement *measurement);
+
+static void
+on_latency_computed (GObject      *source_object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+        LatencyMeasurement *measurement;
+        GtkWidget          *control;
+        GError             *error = NULL;
+        gssize              latency;
+
+        latency = g_task_propagate_int (G_TASK (result), &error);
+        if (error != NULL) {
+                /* The measurement was stopped and freed */
+                g_error_free (error);
+                return;
+        }
+
+        measurement = user_data;
+        control = g_array_index (measurement->controls, GtkWidget *, measurement->step);
+
+        if (latency >= 0) {
+                gchar *text;
+
+                /* Translators: the loopback check heard the speaker, the delay is
+                 * a rough value that includes the delay of the level monitor, far
+                 * too coarse to synchronize audio and video */
+                text = g_strdup_printf (_("Heard, roughly %d ms"), (gint) latency);
+                set_control_latency (control, text);
+                g_free (text);
+        } else {
+                set_control_latency (control, _("Not heard"));
+        }
+
+        measurement->step++;
+        measure_step (measurement);
+}
+
+static gboolean
+on_latency_capture_done (LatencyMeasurement *measurement)
+{
+        LatencyCapture *capture;
+        GTask          *task;
+        GtkWidget      *control;
+
+        measurement->timeout_id = 0;
+
+        control = g_array_index (measurement->controls, GtkWidget *, measurement->step);
+        set_control_playing (control, FALSE);
+
+        capture = g_new0 (LatencyCapture, 1);
+        capture->times = measurement->times;
+        capture->values = measurement->values;
+
+        measurement->times = g_array_new (FALSE, FALSE, sizeof (gint64));
+        measurement->values = g_array_new (FALSE, FALSE, sizeof (gfloat));
+
+        task = g_task_new (NULL, measurement->cancellable, on_latency_computed, measurement);
+        g_task_set_task_data (task, capture, (GDestroyNotify) latency_capture_free);
+        g_task_run_in_thread (task, latency_thread);
+        g_object_unref (task);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+on_latency_monitor_value (MateMixerStreamControl *control,
+                          gdouble                 value,
+                          LatencyMeasurement     *measurement)
+{
+        gint64 time;
+        gfloat level;
+
+        if (measurement->timeout_id == 0)
+                return;
+
+        time  = g_get_monotonic_time () - measurement->start_time;
+        level = (gfloat) MAX (value, 0.0);
+
+        g_array_append_val (measurement->times, time);
+        g_array_append_val (measurement->values, level);
+}
+
+static void
+measure_step (LatencyMeasurement *measurement)
+{
+        GvcSpeakerTest *test = measurement->test;
+        const gchar    *path;
+
+        path = gvc_test_signal_get_file (GVC_TEST_SIGNAL_SWEEP, 0.0, NULL);
+
+        while (measurement->step < measurement->controls->len) {
+                GtkWidget                *control;
+                ca_proplist              *proplist;
+                MateMixerChannelPosition  position;
+                int                       res;
+
+                control = g_array_index (measurement->controls, GtkWidget *, measurement->step);
+                if (path == NULL) {
+                        set_control_latency (control, _("Failed"));
+                        measurement->step++;
+                        continue;
+                }
+
+                position = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (control), "position"));
+
+                proplist = create_proplist (position);
+                ca_proplist_sets (proplist, CA_PROP_MEDIA_FILENAME, path);
+
+                g_array_set_size (measurement->times, 0);
+                g_array_set_size (measurement->values, 0);
+
+                measurement->start_time = g_get_monotonic_time ();
+
+                res = ca_context_play_full (test->priv->canberra, 2, proplist, NULL, NULL);
+                ca_proplist_destroy (proplist);
+
+                if (res < 0) {
+                        set_control_latency (control, _("Failed"));
+                        measurement->step++;
+                        continue;
+                }
+
+                set_control_playing (control, TRUE);
+
+                measurement->timeout_id =
+                        g_timeout_add (GVC_TEST_SIGNAL_DURATION_MS + LATENCY_MAX_MS,
+                                       (GSourceFunc) on_latency_capture_done,
+                                       measurement);
+                return;
+        }
+
+        stop_measurement (test);
+}
+
+static void
+stop_measurement (GvcSpeakerTest *test)
+{
+        LatencyMeasurement *measurement = test->priv->measurement;
+
+        if (measurement == NULL)
+                return;
+
+        test->priv->measurement = NULL;
+
+        g_cancellable_cancel (measurement->cancellable);
+        g_object_unref (measurement->cancellable);
+
+        if (measurement->timeout_id != 0) {
+                g_source_remove (measurement->timeout_id);
+
+                ca_context_cancel (test->priv->canberra, 2);
+
+                if (test->priv->disposed == FALSE) {
+                        GtkWidget *control;
+
+                        control = g_array_index (measurement->controls, GtkWidget *, measurement->step);
+                        set_control_playing (control, FALSE);
+                }
+        }
+
+        g_signal_handlers_disconnect_by_func (G_OBJECT (measurement->input),
+                                              G_CALLBACK (on_latency_monitor_value),
+                                              measurement);
+
+        mate_mixer_stream_control_set_monitor_enabled (measurement->input,
+                                                       measurement->monitor_was_enabled);
+        g_object_unref (measurement->input);
+
+        g_array_unref (measurement->controls);
+        g_array_unref (measurement->times);
+        g_array_unref (measurement->values);
+        g_free (measurement);
+}
+
+/**
+ * gvc_speaker_test_check_loopback:
+ * @test: a #GvcSpeakerTest
+ * @input: a control of the input picking up the speakers
+ *
+ * Plays a sweep on each speaker position in turn and looks for its onset
+ * in the peak levels reported by @input, the onset is found by correlating
+ * with the envelope of the sweep in a worker thread. Below each position is
+ * shown whether it was heard, with a rough delay.
+ *
+ * Only peak levels are available, a few times per second, and the delay of
+ * the level monitor itself is included. The delay only helps to spot a
+ * position that is heard much later than the others, it is far too coarse
+ * for audio and video synchronization.
+ */
+void
+gvc_speaker_test_check_loopback (GvcSpeakerTest         *test,
+                                 MateMixerStreamControl *input)
+{
+        LatencyMeasurement *measurement;
+        guint               i;
+
+        g_return_if_fail (GVC_IS_SPEAKER_TEST (test));
+        g_return_if_fail (MATE_MIXER_IS_STREAM_CONTROL (input));
+
+        stop_walk (test);
+        stop_measurement (test);
+
+        ca_context_cancel (test->priv->canberra, 1);
+
+        measurement = g_new0 (LatencyMeasurement, 1);
+        measurement->test = test;
+        measurement->input = g_object_ref (input);
+        measurement->controls = g_array_new (FALSE, FALSE, sizeof (GtkWidget *));
+        measurement->times = g_array_new (FALSE, FALSE, sizeof (gint64));
+        measurement->values = g_array_new (FALSE, FALSE, sizeof (gfloat));
+        measurement->cancellable = g_cancellable_new ();
+
+        for (i = 0; i < test->priv->controls->len; i++) {
+                GtkWidget *control = g_array_index (test->priv->controls, GtkWidget *, i);
+
+                /* Stop the single tests */
+                if (GPOINTER_TO_INT (g_object_get_data (G_OBJECT (control), "playing")))
+                        set_control_playing (control, FALSE);
+
+                if (gtk_widget_get_visible (control) == FALSE)
+                        continue;
+
+                set_control_latency (control, NULL);
+                g_array_append_val (measurement->controls, control);
+        }
+
+        measurement->monitor_was_enabled =
+                mate_mixer_stream_control_get_monitor_enabled (input);
+
+        g_signal_connect (G_OBJECT (input),
+                          "monitor-value",
+                          G_CALLBACK (on_latency_monitor_value),
+                          measurement);
+
+        mate_mixer_stream_control_set_monitor_enabled (input, TRUE);
+
+        test->priv->measurement = measurement;
+
+        measure_step (measurement);
+}
+
 static GtkWidget *
-create_control (ca_context *canberra, MateMixerChannelPosition position)
+create_control (MateMixerChannelPosition position)
 {
         GtkWidget   *control;
         GtkWidget   *box;
         GtkWidget   *label;
         GtkWidget   *image;
         GtkWidget   *test_button;
+        GtkWidget   *latency_label;
         const gchar *name;
 
         control = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
@@ -351,7 +1156,6 @@ create_control (ca_context *canberra, MateMixerChannelPosition position)
 
         g_object_set_data (G_OBJECT (control), "playing", GINT_TO_POINTER (FALSE));
         g_object_set_data (G_OBJECT (control), "position", GINT_TO_POINTER (position));
-        g_object_set_data (G_OBJECT (control), "canberra", canberra);
 
         name = icon_name (position, FALSE);
         if (name == NULL)
@@ -376,6 +1180,12 @@ create_control (ca_context *canberra, MateMixerChannelPosition position)
         gtk_box_pack_start (GTK_BOX (box), test_button, TRUE, FALSE, 0);
         gtk_box_pack_start (GTK_BOX (control), box, FALSE, FALSE, 0);
 
+        /* Only shown once the loopback was checked */
+        latency_label = gtk_label_new (NULL);
+        gtk_widget_set_no_show_all (latency_label, TRUE);
+        g_object_set_data (G_OBJECT (control), "latency-label", latency_label);
+        gtk_box_pack_start (GTK_BOX (control), latency_label, FALSE, FALSE, 0);
+
         gtk_widget_show_all (control);
 
         return control;
@@ -387,7 +1197,7 @@ create_controls (GvcSpeakerTest *test)
         guint i;
 
         for (i = 0; i < G_N_ELEMENTS (positions); i++) {
-                GtkWidget *control = create_control (test->priv->canberra, positions[i].position);
+                GtkWidget *control = create_control (positions[i].position);
 
                 gtk_grid_attach (GTK_GRID (test),
                                  control,
@@ -431,7 +1241,14 @@ gvc_speaker_test_init (GvcSpeakerTest *test)
                                  CA_PROP_APPLICATION_ICON_NAME, "multimedia-volume-control",
                                  NULL);
 
+        /* Generate the test signals up front, so that the first test
+         * starts right away */
+        gvc_test_signal_get_file (GVC_TEST_SIGNAL_PINK_NOISE, 0.0, NULL);
+        gvc_test_signal_get_file (GVC_TEST_SIGNAL_SINE, LFE_TEST_FREQUENCY, NULL);
+
         test->priv->controls = g_array_new (FALSE, FALSE, sizeof (GtkWidget *));
+        test->priv->steps = g_array_new (FALSE, FALSE, sizeof (SpeakerTestStep));
+        test->priv->channel = completion_channel_new (test);
 
         create_controls (test);
 }
@@ -445,6 +1262,16 @@ gvc_speaker_test_dispose (GObject *object)
 
         g_clear_object (&test->priv->stream);
 
+        /* Pending completions must not touch the controls anymore */
+        test->priv->disposed = TRUE;
+
+        if (test->priv->channel != NULL) {
+                completion_channel_close (test->priv->channel);
+                test->priv->channel = NULL;
+        }
+
+        stop_measurement (test);
+
         G_OBJECT_CLASS (gvc_speaker_test_parent_class)->dispose (object);
 }
 
@@ -457,6 +1284,10 @@ gvc_speaker_test_finalize (GObject *object)
 
         ca_context_destroy (test->priv->canberra);
 
+        clear_steps (test);
+        g_array_free (test->priv->steps, TRUE);
+        g_array_free (test->priv->controls, TRUE);
+
         G_OBJECT_CLASS (gvc_speaker_test_parent_class)->finalize (object);
 }
 
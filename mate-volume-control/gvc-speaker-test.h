@@ -59,6 +59,11 @@ GtkWidget *         gvc_speaker_test_new                 (MateMixerStream *strea
 
 MateMixerStream *   gvc_speaker_test_get_stream          (GvcSpeakerTest  *test);
 
+void                gvc_speaker_test_play_all            (GvcSpeakerTest  *test);
+
+void                gvc_speaker_test_check_loopback      (GvcSpeakerTest         *test,
+                                                          MateMixerStreamControl *input);
+
 G_END_DECLS
 
 #endif /* __GVC_SPEAKER_TEST_H */
@@ -32,6 +32,7 @@
 
 #include "gvc-status-icon.h"
 #include "gvc-stream-status-icon.h"
+#include "gvc-trace.h"
 
 static const gchar *icon_names_output[] = {
         "audio-volume-muted",
@@ -63,6 +64,7 @@ G_DEFINE_TYPE_WITH_PRIVATE (GvcStatusIcon, gvc_status_icon, G_TYPE_OBJECT)
 static void
 update_icon_input (GvcStatusIcon *status_icon)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStreamControl *control = NULL;
         gboolean                show = FALSE;
 
@@ -132,6 +134,7 @@ update_icon_input (GvcStatusIcon *status_icon)
         }
 
         gvc_stream_status_icon_set_control (status_icon->priv->icon_input, control);
+        gvc_trace_watch (control);
 
         gtk_status_icon_set_visible (GTK_STATUS_ICON (status_icon->priv->icon_input), show);
 }
@@ -139,6 +142,7 @@ update_icon_input (GvcStatusIcon *status_icon)
 static void
 update_icon_output (GvcStatusIcon *status_icon)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStream        *stream;
         MateMixerStreamControl *control = NULL;
 
@@ -147,6 +151,7 @@ update_icon_output (GvcStatusIcon *status_icon)
                 control = mate_mixer_stream_get_default_control (stream);
 
         gvc_stream_status_icon_set_control (status_icon->priv->icon_output, control);
+        gvc_trace_watch (control);
 
         if (control != NULL) {
                 g_debug ("Output icon enabled");
@@ -165,6 +170,7 @@ on_input_stream_control_added (MateMixerStream *stream,
                                const gchar     *name,
                                GvcStatusIcon       *status_icon)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerStreamControl *control;
 
         control = mate_mixer_stream_get_control (stream, name);
@@ -188,6 +194,8 @@ on_input_stream_control_removed (MateMixerStream *stream,
                                  const gchar     *name,
                                  GvcStatusIcon       *status_icon)
 {
+        GVC_TRACE_FUNCTION ();
+
         /* The removed stream could be an application input, which may cause
          * the input status icon to disappear */
         update_icon_input (status_icon);
@@ -230,6 +238,7 @@ on_context_state_notify (MateMixerContext *context,
                          GParamSpec       *pspec,
                          GvcStatusIcon        *status_icon)
 {
+        GVC_TRACE_FUNCTION ();
         MateMixerState state = mate_mixer_context_get_state (context);
 
         switch (state) {
@@ -254,6 +263,8 @@ on_context_default_input_stream_notify (MateMixerContext *context,
                                         GParamSpec       *pspec,
                                         GvcStatusIcon        *status_icon)
 {
+        GVC_TRACE_FUNCTION ();
+
         if (update_default_input_stream (status_icon) == FALSE)
                 return;
 
@@ -265,6 +276,8 @@ on_context_default_output_stream_notify (MateMixerContext *control,
                                          GParamSpec       *pspec,
                                          GvcStatusIcon        *status_icon)
 {
+        GVC_TRACE_FUNCTION ();
+
         update_icon_output (status_icon);
 }
 
@@ -330,6 +343,7 @@ gvc_status_icon_init (GvcStatusIcon *status_icon)
                                    _("Sound Output Volume"));
 
         status_icon->priv->context = mate_mixer_context_new ();
+        gvc_trace_watch (status_icon->priv->context);
 
         mate_mixer_context_set_app_name (status_icon->priv->context,
                                          _("MATE Volume Control StatusIcon"));
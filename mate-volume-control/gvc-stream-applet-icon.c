@@ -40,6 +40,8 @@
 
 #include "gvc-channel-bar.h"
 #include "gvc-stream-applet-icon.h"
+#include "gvc-frame-overlay.h"
+#include "gvc-trace.h"
 
 struct _GvcStreamAppletIconPrivate
 {
@@ -53,8 +55,18 @@ struct _GvcStreamAppletIconPrivate
         MateMixerStreamControl *control;
         MatePanelAppletOrient   orient;
         guint                   size;
+        GdkRectangle            dock_area;
+        MatePanelAppletOrient   dock_orient;
+        GtkRequisition          dock_req;
+        gboolean                dock_placed;
+        guint                   dock_prepare_id;
+        guint                   dock_release_id;
 };
 
+/* How long the dock is kept after it was last hidden, it is built again
+ * when the pointer next enters the icon */
+#define DOCK_RELEASE_TIMEOUT    300
+
 enum
 {
         PROP_0,
@@ -68,43 +80,172 @@ static GParamSpec *properties[N_PROPERTIES] = { NULL, };
 
 static void gvc_stream_applet_icon_finalize   (GObject *object);
 
+static void create_dock                       (GvcStreamAppletIcon *icon);
+
 G_DEFINE_TYPE_WITH_PRIVATE (GvcStreamAppletIcon, gvc_stream_applet_icon, GTK_TYPE_EVENT_BOX)
 
-static gboolean
-popup_dock (GvcStreamAppletIcon *icon, guint time)
+/* Moves the dock next to the icon, the position is only computed again
+ * when the icon, the panel orientation, the monitors or the size of the
+ * dock have changed */
+static void
+place_dock (GvcStreamAppletIcon *icon, GdkScreen *screen, GdkRectangle *area)
 {
-        GtkAllocation  allocation;
-        GdkDisplay    *display;
-        GdkScreen     *screen;
         int            x, y;
         GdkMonitor    *monitor_num;
         GdkRectangle   monitor;
         GtkRequisition dock_req;
 
+        gtk_window_set_screen (GTK_WINDOW (icon->priv->dock), screen);
+
+        if (icon->priv->dock_placed == FALSE || icon->priv->orient != icon->priv->dock_orient) {
+                switch (icon->priv->orient) {
+                    case MATE_PANEL_APPLET_ORIENT_LEFT:
+                    case MATE_PANEL_APPLET_ORIENT_RIGHT:
+                        gvc_channel_bar_set_orientation (GVC_CHANNEL_BAR (icon->priv->bar), GTK_ORIENTATION_HORIZONTAL);
+                        break;
+                    case MATE_PANEL_APPLET_ORIENT_UP:
+                    case MATE_PANEL_APPLET_ORIENT_DOWN:
+                    default:
+                        gvc_channel_bar_set_orientation (GVC_CHANNEL_BAR (icon->priv->bar), GTK_ORIENTATION_VERTICAL);
+                }
+        }
+
+        gtk_widget_get_preferred_size (icon->priv->dock, &dock_req, NULL);
+
+        if (icon->priv->dock_placed != FALSE &&
+            icon->priv->orient == icon->priv->dock_orient &&
+            gdk_rectangle_equal (area, &icon->priv->dock_area) &&
+            dock_req.width == icon->priv->dock_req.width &&
+            dock_req.height == icon->priv->dock_req.height)
+                return;
+
+        monitor_num = gdk_display_get_monitor_at_point (gdk_screen_get_display (screen), area->x, area->y);
+        gdk_monitor_get_geometry (monitor_num, &monitor);
+
+        if (icon->priv->orient == MATE_PANEL_APPLET_ORIENT_LEFT || icon->priv->orient == MATE_PANEL_APPLET_ORIENT_RIGHT) {
+                if (area->x + area->width + dock_req.width <= monitor.x + monitor.width)
+                        x = area->x + area->width;
+                else
+                        x = area->x - dock_req.width;
+
+                if (area->y + dock_req.height <= monitor.y + monitor.height)
+                        y = area->y;
+                else
+                        y = monitor.y + monitor.height - dock_req.height;
+        } else {
+                if (area->y + area->height + dock_req.height <= monitor.y + monitor.height)
+                        y = area->y + area->height;
+                else
+                        y = area->y - dock_req.height;
+
+                if (area->x + dock_req.width <= monitor.x + monitor.width)
+                        x = area->x;
+                else
+                        x = monitor.x + monitor.width - dock_req.width;
+        }
+
+        gtk_window_move (GTK_WINDOW (icon->priv->dock), x, y);
+
+        /* Without this, the popup window appears as a square after changing
+         * the orientation */
+        gtk_window_resize (GTK_WINDOW (icon->priv->dock), 1, 1);
+
+        icon->priv->dock_area   = *area;
+        icon->priv->dock_orient = icon->priv->orient;
+        icon->priv->dock_req    = dock_req;
+        icon->priv->dock_placed = TRUE;
+}
+
+static void
+get_icon_area (GvcStreamAppletIcon *icon, GdkRectangle *area)
+{
+        gtk_widget_get_allocation (GTK_WIDGET (icon), area);
+        gdk_window_get_origin (gtk_widget_get_window (GTK_WIDGET (icon)), &area->x, &area->y);
+}
+
+/* Realizes and places the hidden dock, so that a click on the icon only
+ * has to map it */
+static gboolean
+prepare_dock (GvcStreamAppletIcon *icon)
+{
+        GdkRectangle area;
+
+        icon->priv->dock_prepare_id = 0;
+
+        if (gtk_widget_get_visible (icon->priv->dock) != FALSE)
+                return G_SOURCE_REMOVE;
+
+        gtk_container_foreach (GTK_CONTAINER (icon->priv->dock), (GtkCallback) gtk_widget_show_all, NULL);
+
+#if defined(ENABLE_WAYLAND)
+        /* The layer surface has to be set up before the window is realized */
+        if (GDK_IS_WAYLAND_DISPLAY (gtk_widget_get_display (GTK_WIDGET (icon)))) {
+                if (!gtk_layer_is_layer_window (GTK_WINDOW (icon->priv->dock)))
+                {
+                    gtk_layer_init_for_window (GTK_WINDOW (icon->priv->dock));
+                    gtk_layer_set_layer (GTK_WINDOW (icon->priv->dock), GTK_LAYER_SHELL_LAYER_TOP);
+                    gtk_layer_set_keyboard_mode (GTK_WINDOW (icon->priv->dock), GTK_LAYER_SHELL_KEYBOARD_MODE_ON_DEMAND);
+                }
+        }
+#endif
+
+        /* The position is not known until the applet is in the panel */
+        if (gtk_widget_get_realized (GTK_WIDGET (icon))) {
+                get_icon_area (icon, &area);
+                place_dock (icon, gtk_widget_get_screen (GTK_WIDGET (icon)), &area);
+        }
+
+        gtk_widget_realize (icon->priv->dock);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+queue_prepare_dock (GvcStreamAppletIcon *icon, gboolean replace)
+{
+        if (replace != FALSE)
+                icon->priv->dock_placed = FALSE;
+
+        if (icon->priv->dock == NULL || icon->priv->dock_prepare_id != 0)
+                return;
+
+        icon->priv->dock_prepare_id =
+                g_idle_add_full (G_PRIORITY_LOW,
+                                 (GSourceFunc) prepare_dock,
+                                 icon,
+                                 NULL);
+}
+
+static gboolean
+popup_dock (GvcStreamAppletIcon *icon, guint time)
+{
+        GdkRectangle   allocation;
+        GdkDisplay    *display;
+        GdkScreen     *screen;
+
         screen = gtk_widget_get_screen (GTK_WIDGET (icon));
-        gtk_widget_get_allocation (GTK_WIDGET (icon), &allocation);
-        gdk_window_get_origin (gtk_widget_get_window (GTK_WIDGET (icon)), &allocation.x, &allocation.y);
+        get_icon_area (icon, &allocation);
         gtk_widget_set_state_flags (GTK_WIDGET (icon), GTK_STATE_FLAG_CHECKED, FALSE);
 
-        /* position roughly */
-        gtk_window_set_screen (GTK_WINDOW (icon->priv->dock), screen);
-        switch (icon->priv->orient) {
-            case MATE_PANEL_APPLET_ORIENT_LEFT:
-            case MATE_PANEL_APPLET_ORIENT_RIGHT:
-                gvc_channel_bar_set_orientation (GVC_CHANNEL_BAR (icon->priv->bar), GTK_ORIENTATION_HORIZONTAL);
-                break;
-            case MATE_PANEL_APPLET_ORIENT_UP:
-            case MATE_PANEL_APPLET_ORIENT_DOWN:
-            default:
-                gvc_channel_bar_set_orientation (GVC_CHANNEL_BAR (icon->priv->bar), GTK_ORIENTATION_VERTICAL);
+        display = gdk_screen_get_display (screen);
+
+        create_dock (icon);
+
+        if (icon->priv->dock_release_id != 0) {
+                g_source_remove (icon->priv->dock_release_id);
+                icon->priv->dock_release_id = 0;
         }
 
-        display = gdk_screen_get_display (screen);
-        monitor_num = gdk_display_get_monitor_at_point (display, allocation.x, allocation.y);
-        gdk_monitor_get_geometry (monitor_num, &monitor);
+        if (icon->priv->dock_prepare_id != 0) {
+                g_source_remove (icon->priv->dock_prepare_id);
+                icon->priv->dock_prepare_id = 0;
+        }
 
+        /* The dock is measured by place_dock, its children have to be shown
+         * even if the dock was built without being prepared, as by a scroll */
         gtk_container_foreach (GTK_CONTAINER (icon->priv->dock), (GtkCallback) gtk_widget_show_all, NULL);
-        gtk_widget_get_preferred_size (icon->priv->dock, &dock_req, NULL);
+
+        place_dock (icon, screen, &allocation);
 
 #if defined(ENABLE_WAYLAND)
         if (GDK_IS_WAYLAND_DISPLAY (display))
@@ -176,34 +317,6 @@ popup_dock (GvcStreamAppletIcon *icon, guint time)
         }
 #endif /* wayland support */
 
-        if (icon->priv->orient == MATE_PANEL_APPLET_ORIENT_LEFT || icon->priv->orient == MATE_PANEL_APPLET_ORIENT_RIGHT) {
-                if (allocation.x + allocation.width + dock_req.width <= monitor.x + monitor.width)
-                        x = allocation.x + allocation.width;
-                else
-                        x = allocation.x - dock_req.width;
-
-                if (allocation.y + dock_req.height <= monitor.y + monitor.height)
-                        y = allocation.y;
-                else
-                        y = monitor.y + monitor.height - dock_req.height;
-        } else {
-                if (allocation.y + allocation.height + dock_req.height <= monitor.y + monitor.height)
-                        y = allocation.y + allocation.height;
-                else
-                        y = allocation.y - dock_req.height;
-
-                if (allocation.x + dock_req.width <= monitor.x + monitor.width)
-                        x = allocation.x;
-                else
-                        x = monitor.x + monitor.width - dock_req.width;
-        }
-
-        gtk_window_move (GTK_WINDOW (icon->priv->dock), x, y);
-
-        /* Without this, the popup window appears as a square after changing
-         * the orientation */
-        gtk_window_resize (GTK_WINDOW (icon->priv->dock), 1, 1);
-
         gtk_widget_show_all (icon->priv->dock);
 
         /* Grab focus */
@@ -271,7 +384,7 @@ gvc_stream_applet_icon_volume_control (GvcStreamAppletIcon *icon)
 {
         GError *error = NULL;
 
-        mate_gdk_spawn_command_line_on_screen (gtk_widget_get_screen (icon->priv->dock),
+        mate_gdk_spawn_command_line_on_screen (gtk_widget_get_screen (GTK_WIDGET (icon)),
                                                "mate-volume-control",
                                                &error);
 
@@ -298,9 +411,50 @@ on_applet_icon_scroll_event (GtkWidget           *event_box,
                              GdkEventScroll      *event,
                              GvcStreamAppletIcon *icon)
 {
+        /* The bar knows the scroll step of the control */
+        create_dock (icon);
+
         return gvc_channel_bar_scroll (GVC_CHANNEL_BAR (icon->priv->bar), event->direction);
 }
 
+/* Destroys the dock which has not been shown for a while, keeping it
+ * would only hold its widgets and window resources */
+static gboolean
+release_dock (GvcStreamAppletIcon *icon)
+{
+        icon->priv->dock_release_id = 0;
+
+        if (icon->priv->dock == NULL || gtk_widget_get_visible (icon->priv->dock) != FALSE)
+                return G_SOURCE_REMOVE;
+
+        if (icon->priv->dock_prepare_id != 0) {
+                g_source_remove (icon->priv->dock_prepare_id);
+                icon->priv->dock_prepare_id = 0;
+        }
+
+        g_debug ("Releasing the dock of %s", icon->priv->display_name);
+
+        gtk_widget_destroy (icon->priv->dock);
+
+        icon->priv->dock        = NULL;
+        icon->priv->bar         = NULL;
+        icon->priv->dock_placed = FALSE;
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+queue_release_dock (GvcStreamAppletIcon *icon)
+{
+        if (icon->priv->dock_release_id != 0)
+                g_source_remove (icon->priv->dock_release_id);
+
+        icon->priv->dock_release_id =
+                g_timeout_add_seconds (DOCK_RELEASE_TIMEOUT,
+                                       (GSourceFunc) release_dock,
+                                       icon);
+}
+
 static void
 gvc_icon_release_grab (GvcStreamAppletIcon *icon, GdkEventButton *event)
 {
@@ -312,6 +466,8 @@ gvc_icon_release_grab (GvcStreamAppletIcon *icon, GdkEventButton *event)
         /* Hide again */
         gtk_widget_unset_state_flags (GTK_WIDGET (icon), GTK_STATE_FLAG_CHECKED);
         gtk_widget_hide (icon->priv->dock);
+
+        queue_release_dock (icon);
 }
 
 static gboolean
@@ -340,6 +496,8 @@ popdown_dock (GvcStreamAppletIcon *icon)
         /* Hide again */
         gtk_widget_unset_state_flags (GTK_WIDGET (icon), GTK_STATE_FLAG_CHECKED);
         gtk_widget_hide (icon->priv->dock);
+
+        queue_release_dock (icon);
 }
 
 /* This is called when the grab is broken for either the dock, or the scale */
@@ -417,6 +575,7 @@ gvc_stream_applet_icon_set_icon_from_name (GvcStreamAppletIcon *icon,
 static void
 update_icon (GvcStreamAppletIcon *icon)
 {
+        GVC_TRACE_FUNCTION ();
         guint                       volume = 0;
         gdouble                     decibel = 0;
         guint                       normal = 0;
@@ -518,6 +677,8 @@ gvc_stream_applet_icon_set_size (GvcStreamAppletIcon *icon,
 
         icon->priv->size = size;
         gvc_stream_applet_icon_set_icon_from_name (icon, icon->priv->icon_names[icon->priv->current_icon]);
+
+        queue_prepare_dock (icon, TRUE);
 }
 
 void
@@ -532,6 +693,8 @@ gvc_stream_applet_icon_set_orient (GvcStreamAppletIcon  *icon,
                 icon->priv->orient = orient;
         else
                 icon->priv->orient = MATE_PANEL_APPLET_ORIENT_DOWN;
+
+        queue_prepare_dock (icon, TRUE);
 }
 
 void
@@ -563,6 +726,8 @@ on_stream_control_volume_notify (MateMixerStreamControl *control,
                                  GParamSpec             *pspec,
                                  GvcStreamAppletIcon    *icon)
 {
+        GVC_TRACE_FUNCTION ();
+
         update_icon (icon);
 }
 
@@ -571,6 +736,8 @@ on_stream_control_mute_notify (MateMixerStreamControl *control,
                                GParamSpec             *pspec,
                                GvcStreamAppletIcon    *icon)
 {
+        GVC_TRACE_FUNCTION ();
+
         update_icon (icon);
 }
 
@@ -627,7 +794,8 @@ gvc_stream_applet_icon_set_control (GvcStreamAppletIcon    *icon,
                 update_icon (icon);
         }
 
-        gvc_channel_bar_set_control (GVC_CHANNEL_BAR (icon->priv->bar), icon->priv->control);
+        if (icon->priv->bar != NULL)
+                gvc_channel_bar_set_control (GVC_CHANNEL_BAR (icon->priv->bar), icon->priv->control);
 
         g_object_notify_by_pspec (G_OBJECT (icon), properties[PROP_CONTROL]);
 }
@@ -685,9 +853,19 @@ gvc_stream_applet_icon_dispose (GObject *object)
 {
         GvcStreamAppletIcon *icon = GVC_STREAM_APPLET_ICON (object);
 
+        if (icon->priv->dock_prepare_id != 0) {
+                g_source_remove (icon->priv->dock_prepare_id);
+                icon->priv->dock_prepare_id = 0;
+        }
+        if (icon->priv->dock_release_id != 0) {
+                g_source_remove (icon->priv->dock_release_id);
+                icon->priv->dock_release_id = 0;
+        }
+
         if (icon->priv->dock != NULL) {
                 gtk_widget_destroy (icon->priv->dock);
                 icon->priv->dock = NULL;
+                icon->priv->bar  = NULL;
         }
 
         g_clear_object (&icon->priv->control);
@@ -738,13 +916,38 @@ gvc_stream_applet_icon_class_init (GvcStreamAppletIconClass *klass)
         g_object_class_install_properties (object_class, N_PROPERTIES, properties);
 }
 
+static void
+on_screen_monitors_changed (GdkScreen           *screen,
+                            GvcStreamAppletIcon *icon)
+{
+        queue_prepare_dock (icon, TRUE);
+}
+
 static void
 on_applet_icon_visible_notify (GvcStreamAppletIcon *icon)
 {
-        if (gtk_widget_get_visible (GTK_WIDGET (icon)) == FALSE)
+        if (gtk_widget_get_visible (GTK_WIDGET (icon)) == FALSE && icon->priv->dock != NULL)
                 gtk_widget_hide (icon->priv->dock);
 }
 
+/* The pointer over the icon is the hint that the dock is about to be
+ * needed, which leaves it the time to be built before a click */
+static gboolean
+on_applet_icon_enter_notify (GtkWidget           *widget,
+                             GdkEventCrossing    *event,
+                             GvcStreamAppletIcon *icon)
+{
+        if (icon->priv->dock == NULL) {
+                create_dock (icon);
+                queue_prepare_dock (icon, FALSE);
+        }
+
+        if (gtk_widget_get_visible (icon->priv->dock) == FALSE)
+                queue_release_dock (icon);
+
+        return FALSE;
+}
+
 static void
 on_icon_theme_change (GtkSettings         *settings,
                       GParamSpec          *pspec,
@@ -753,37 +956,25 @@ on_icon_theme_change (GtkSettings         *settings,
         gvc_stream_applet_icon_set_icon_from_name (icon, icon->priv->icon_names[icon->priv->current_icon]);
 }
 
+/* Builds the dock window with its channel bar, unless it already exists */
 static void
-gvc_stream_applet_icon_init (GvcStreamAppletIcon *icon)
+create_dock (GvcStreamAppletIcon *icon)
 {
-        GtkWidget *frame;
-        GtkWidget *box;
-
-        icon->priv = gvc_stream_applet_icon_get_instance_private (icon);
-
-        icon->priv->sound_settings = g_settings_new ("org.mate.sound");
+        GtkWidget       *frame;
+        GtkWidget       *box;
+        GtkStyleContext *context;
+        GdkScreen       *screen;
+        GdkVisual       *visual;
 
-        icon->priv->image = GTK_IMAGE (gtk_image_new ());
-        gtk_container_add (GTK_CONTAINER (icon), GTK_WIDGET (icon->priv->image));
-        gtk_style_context_add_class (gtk_widget_get_style_context (GTK_WIDGET (icon)), "menu-button"); // icon = volume-applet
+        if (icon->priv->dock != NULL)
+                return;
 
-        g_signal_connect (GTK_WIDGET (icon),
-                          "button-press-event",
-                          G_CALLBACK (on_applet_icon_button_press),
-                          icon);
-        g_signal_connect (GTK_WIDGET (icon),
-                          "scroll-event",
-                          G_CALLBACK (on_applet_icon_scroll_event),
-                          icon);
-        g_signal_connect (GTK_WIDGET (icon),
-                          "notify::visible",
-                          G_CALLBACK (on_applet_icon_visible_notify),
-                          NULL);
+        g_debug ("Creating the dock of %s", icon->priv->display_name);
 
-        /* Create the dock window */
         icon->priv->dock = gtk_window_new (GTK_WINDOW_POPUP);
 
         gtk_window_set_decorated (GTK_WINDOW (icon->priv->dock), FALSE);
+        gvc_frame_overlay_attach (icon->priv->dock);
 
         g_signal_connect (G_OBJECT (icon->priv->dock),
                           "button-press-event",
@@ -827,15 +1018,13 @@ gvc_stream_applet_icon_init (GvcStreamAppletIcon *icon)
                          G_SETTINGS_BIND_GET);
 
         /* Set volume control frame, slider and toplevel window to follow panel theme */
-        GtkWidget *toplevel = gtk_widget_get_toplevel (icon->priv->dock);
-        GtkStyleContext *context;
-        context = gtk_widget_get_style_context (GTK_WIDGET(toplevel));
-        gtk_style_context_add_class(context,"mate-panel-applet-slider");
+        context = gtk_widget_get_style_context (icon->priv->dock);
+        gtk_style_context_add_class (context, "mate-panel-applet-slider");
 
         /* Make transparency possible in gtk3 theme */
-        GdkScreen *screen = gtk_widget_get_screen(GTK_WIDGET(toplevel));
-        GdkVisual *visual = gdk_screen_get_rgba_visual(screen);
-        gtk_widget_set_visual(GTK_WIDGET(toplevel), visual);
+        screen = gtk_widget_get_screen (icon->priv->dock);
+        visual = gdk_screen_get_rgba_visual (screen);
+        gtk_widget_set_visual (icon->priv->dock, visual);
 
         box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
 
@@ -844,10 +1033,49 @@ gvc_stream_applet_icon_init (GvcStreamAppletIcon *icon)
 
         gtk_box_pack_start (GTK_BOX (box), icon->priv->bar, TRUE, FALSE, 0);
 
+        gvc_channel_bar_set_control (GVC_CHANNEL_BAR (icon->priv->bar), icon->priv->control);
+}
+
+static void
+gvc_stream_applet_icon_init (GvcStreamAppletIcon *icon)
+{
+        icon->priv = gvc_stream_applet_icon_get_instance_private (icon);
+
+        icon->priv->sound_settings = g_settings_new ("org.mate.sound");
+
+        icon->priv->image = GTK_IMAGE (gtk_image_new ());
+        gtk_container_add (GTK_CONTAINER (icon), GTK_WIDGET (icon->priv->image));
+        gtk_style_context_add_class (gtk_widget_get_style_context (GTK_WIDGET (icon)), "menu-button"); // icon = volume-applet
+
+        g_signal_connect (GTK_WIDGET (icon),
+                          "button-press-event",
+                          G_CALLBACK (on_applet_icon_button_press),
+                          icon);
+        g_signal_connect (GTK_WIDGET (icon),
+                          "scroll-event",
+                          G_CALLBACK (on_applet_icon_scroll_event),
+                          icon);
+        g_signal_connect (GTK_WIDGET (icon),
+                          "enter-notify-event",
+                          G_CALLBACK (on_applet_icon_enter_notify),
+                          icon);
+        g_signal_connect (GTK_WIDGET (icon),
+                          "notify::visible",
+                          G_CALLBACK (on_applet_icon_visible_notify),
+                          NULL);
+
         g_signal_connect (gtk_settings_get_default (),
                           "notify::gtk-icon-theme-name",
                           G_CALLBACK (on_icon_theme_change),
                           icon);
+
+        /* The dock is only built when it is about to be used, see
+         * on_applet_icon_enter_notify() */
+        g_signal_connect_object (G_OBJECT (gtk_widget_get_screen (GTK_WIDGET (icon))),
+                                 "monitors-changed",
+                                 G_CALLBACK (on_screen_monitors_changed),
+                                 icon,
+                                 0);
 }
 
 static void
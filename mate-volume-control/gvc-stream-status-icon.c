@@ -33,6 +33,8 @@
 
 #include "gvc-channel-bar.h"
 #include "gvc-stream-status-icon.h"
+#include "gvc-frame-overlay.h"
+#include "gvc-trace.h"
 
 struct _GvcStreamStatusIconPrivate
 {
@@ -43,6 +45,11 @@ struct _GvcStreamStatusIconPrivate
         guint            current_icon;
         gchar           *display_name;
         MateMixerStreamControl *control;
+        GdkRectangle     dock_area;
+        GtkOrientation   dock_orientation;
+        GtkRequisition   dock_req;
+        gboolean         dock_placed;
+        guint            dock_prepare_id;
 };
 
 enum
@@ -60,59 +67,56 @@ static void gvc_stream_status_icon_finalize   (GObject                  *object)
 
 G_DEFINE_TYPE_WITH_PRIVATE (GvcStreamStatusIcon, gvc_stream_status_icon, GTK_TYPE_STATUS_ICON)
 
-static gboolean
-popup_dock (GvcStreamStatusIcon *icon, guint time)
+/* Moves the dock next to the icon, the position is only computed again
+ * when the icon, the monitors or the size of the dock have changed */
+static void
+place_dock (GvcStreamStatusIcon *icon,
+            GdkScreen           *screen,
+            GdkRectangle        *area,
+            GtkOrientation       orientation)
 {
-        GdkRectangle   area;
-        GtkOrientation orientation;
-        GdkDisplay    *display;
-        GdkScreen     *screen;
         int            x;
         int            y;
         GdkMonitor    *monitor_num;
         GdkRectangle   monitor;
         GtkRequisition dock_req;
 
-        screen = gtk_status_icon_get_screen (GTK_STATUS_ICON (icon));
-
-        if (gtk_status_icon_get_geometry (GTK_STATUS_ICON (icon),
-                                          &screen,
-                                          &area,
-                                          &orientation) == FALSE) {
-                g_warning ("Unable to determine geometry of status icon");
-                return FALSE;
-        }
-
-        /* position roughly */
         gtk_window_set_screen (GTK_WINDOW (icon->priv->dock), screen);
-        gvc_channel_bar_set_orientation (GVC_CHANNEL_BAR (icon->priv->bar),
-                                         1 - orientation);
 
-        monitor_num = gdk_display_get_monitor_at_point (gdk_screen_get_display (screen), area.x, area.y);
-        gdk_monitor_get_geometry (monitor_num, &monitor);
+        if (icon->priv->dock_placed == FALSE || orientation != icon->priv->dock_orientation)
+                gvc_channel_bar_set_orientation (GVC_CHANNEL_BAR (icon->priv->bar),
+                                                 1 - orientation);
 
-        gtk_container_foreach (GTK_CONTAINER (icon->priv->dock),
-                               (GtkCallback) gtk_widget_show_all, NULL);
         gtk_widget_get_preferred_size (icon->priv->dock, &dock_req, NULL);
 
+        if (icon->priv->dock_placed != FALSE &&
+            orientation == icon->priv->dock_orientation &&
+            gdk_rectangle_equal (area, &icon->priv->dock_area) &&
+            dock_req.width == icon->priv->dock_req.width &&
+            dock_req.height == icon->priv->dock_req.height)
+                return;
+
+        monitor_num = gdk_display_get_monitor_at_point (gdk_screen_get_display (screen), area->x, area->y);
+        gdk_monitor_get_geometry (monitor_num, &monitor);
+
         if (orientation == GTK_ORIENTATION_VERTICAL) {
-                if (area.x + area.width + dock_req.width <= monitor.x + monitor.width)
-                        x = area.x + area.width;
+                if (area->x + area->width + dock_req.width <= monitor.x + monitor.width)
+                        x = area->x + area->width;
                 else
-                        x = area.x - dock_req.width;
+                        x = area->x - dock_req.width;
 
-                if (area.y + dock_req.height <= monitor.y + monitor.height)
-                        y = area.y;
+                if (area->y + dock_req.height <= monitor.y + monitor.height)
+                        y = area->y;
                 else
                         y = monitor.y + monitor.height - dock_req.height;
         } else {
-                if (area.y + area.height + dock_req.height <= monitor.y + monitor.height)
-                        y = area.y + area.height;
+                if (area->y + area->height + dock_req.height <= monitor.y + monitor.height)
+                        y = area->y + area->height;
                 else
-                        y = area.y - dock_req.height;
+                        y = area->y - dock_req.height;
 
-                if (area.x + dock_req.width <= monitor.x + monitor.width)
-                        x = area.x;
+                if (area->x + dock_req.width <= monitor.x + monitor.width)
+                        x = area->x;
                 else
                         x = monitor.x + monitor.width - dock_req.width;
         }
@@ -123,6 +127,85 @@ popup_dock (GvcStreamStatusIcon *icon, guint time)
          * the orientation */
         gtk_window_resize (GTK_WINDOW (icon->priv->dock), 1, 1);
 
+        icon->priv->dock_area        = *area;
+        icon->priv->dock_orientation = orientation;
+        icon->priv->dock_req         = dock_req;
+        icon->priv->dock_placed      = TRUE;
+}
+
+/* Realizes and places the hidden dock, so that a click on the icon only
+ * has to map it */
+static gboolean
+prepare_dock (GvcStreamStatusIcon *icon)
+{
+        GdkRectangle   area;
+        GtkOrientation orientation;
+        GdkScreen     *screen;
+
+        icon->priv->dock_prepare_id = 0;
+
+        if (gtk_widget_get_visible (icon->priv->dock) != FALSE)
+                return G_SOURCE_REMOVE;
+
+        gtk_container_foreach (GTK_CONTAINER (icon->priv->dock),
+                               (GtkCallback) gtk_widget_show_all, NULL);
+
+        /* The geometry is not known until the icon is embedded */
+        if (gtk_status_icon_get_geometry (GTK_STATUS_ICON (icon),
+                                          &screen,
+                                          &area,
+                                          &orientation) != FALSE)
+                place_dock (icon, screen, &area, orientation);
+
+        gtk_widget_realize (icon->priv->dock);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+queue_prepare_dock (GvcStreamStatusIcon *icon, gboolean replace)
+{
+        if (replace != FALSE)
+                icon->priv->dock_placed = FALSE;
+
+        if (icon->priv->dock == NULL || icon->priv->dock_prepare_id != 0)
+                return;
+
+        icon->priv->dock_prepare_id =
+                g_idle_add_full (G_PRIORITY_LOW,
+                                 (GSourceFunc) prepare_dock,
+                                 icon,
+                                 NULL);
+}
+
+static gboolean
+popup_dock (GvcStreamStatusIcon *icon, guint time)
+{
+        GdkRectangle   area;
+        GtkOrientation orientation;
+        GdkDisplay    *display;
+        GdkScreen     *screen;
+
+        screen = gtk_status_icon_get_screen (GTK_STATUS_ICON (icon));
+
+        if (gtk_status_icon_get_geometry (GTK_STATUS_ICON (icon),
+                                          &screen,
+                                          &area,
+                                          &orientation) == FALSE) {
+                g_warning ("Unable to determine geometry of status icon");
+                return FALSE;
+        }
+
+        if (icon->priv->dock_prepare_id != 0) {
+                g_source_remove (icon->priv->dock_prepare_id);
+                icon->priv->dock_prepare_id = 0;
+
+                gtk_container_foreach (GTK_CONTAINER (icon->priv->dock),
+                                       (GtkCallback) gtk_widget_show_all, NULL);
+        }
+
+        place_dock (icon, screen, &area, orientation);
+
         gtk_widget_show_all (icon->priv->dock);
 
         /* Grab focus */
@@ -381,6 +464,7 @@ on_dock_scroll_event (GtkWidget           *widget,
 static void
 update_icon (GvcStreamStatusIcon *icon)
 {
+        GVC_TRACE_FUNCTION ();
         guint                volume = 0;
         guint                volume_percent = 0;
         gdouble              decibel = 0;
@@ -498,6 +582,8 @@ on_stream_control_volume_notify (MateMixerStreamControl     *control,
                          GParamSpec          *pspec,
                          GvcStreamStatusIcon *icon)
 {
+        GVC_TRACE_FUNCTION ();
+
         update_icon (icon);
 }
 
@@ -506,6 +592,8 @@ on_stream_control_mute_notify (MateMixerStreamControl     *control,
                        GParamSpec          *pspec,
                        GvcStreamStatusIcon *icon)
 {
+        GVC_TRACE_FUNCTION ();
+
         update_icon (icon);
 }
 
@@ -620,6 +708,11 @@ gvc_stream_status_icon_dispose (GObject *object)
 {
         GvcStreamStatusIcon *icon = GVC_STREAM_STATUS_ICON (object);
 
+        if (icon->priv->dock_prepare_id != 0) {
+                g_source_remove (icon->priv->dock_prepare_id);
+                icon->priv->dock_prepare_id = 0;
+        }
+
         if (icon->priv->dock != NULL) {
                 gtk_widget_destroy (icon->priv->dock);
                 icon->priv->dock = NULL;
@@ -670,6 +763,24 @@ gvc_stream_status_icon_class_init (GvcStreamStatusIconClass *klass)
         g_object_class_install_properties (object_class, N_PROPERTIES, properties);
 }
 
+/* Returns FALSE so that GTK still reloads the icon in the new size */
+static gboolean
+on_status_icon_size_changed (GtkStatusIcon       *status_icon,
+                             gint                 size,
+                             GvcStreamStatusIcon *icon)
+{
+        queue_prepare_dock (icon, TRUE);
+
+        return FALSE;
+}
+
+static void
+on_screen_monitors_changed (GdkScreen           *screen,
+                            GvcStreamStatusIcon *icon)
+{
+        queue_prepare_dock (icon, TRUE);
+}
+
 static void
 on_status_icon_visible_notify (GvcStreamStatusIcon *icon)
 {
@@ -716,11 +827,16 @@ gvc_stream_status_icon_init (GvcStreamStatusIcon *icon)
                           "notify::visible",
                           G_CALLBACK (on_status_icon_visible_notify),
                           NULL);
+        g_signal_connect (G_OBJECT (icon),
+                          "size-changed",
+                          G_CALLBACK (on_status_icon_size_changed),
+                          icon);
 
         /* Create the dock window */
         icon->priv->dock = gtk_window_new (GTK_WINDOW_POPUP);
 
         gtk_window_set_decorated (GTK_WINDOW (icon->priv->dock), FALSE);
+        gvc_frame_overlay_attach (icon->priv->dock);
 
         g_signal_connect (G_OBJECT (icon->priv->dock),
                           "button-press-event",
@@ -784,6 +900,15 @@ gvc_stream_status_icon_init (GvcStreamStatusIcon *icon)
                           "notify::gtk-icon-theme-name",
                           G_CALLBACK (on_icon_theme_change),
                           icon);
+
+        g_signal_connect_object (G_OBJECT (screen),
+                                 "monitors-changed",
+                                 G_CALLBACK (on_screen_monitors_changed),
+                                 icon,
+                                 0);
+
+        /* Get the dock ready once the icon is set up */
+        queue_prepare_dock (icon, FALSE);
 }
 
 static void
@@ -0,0 +1,324 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "gvc-test-signal.h"
+
+/* One period of a sine wave, the oscillators index it with the top bits
+ * of a 32-bit phase accumulator */
+#define SINE_TABLE_BITS         12
+#define SINE_TABLE_SIZE         (1 << SINE_TABLE_BITS)
+
+#define SIGNAL_FADE_MS          10
+#define SIGNAL_AMPLITUDE        0.5f
+
+#define SWEEP_START_FREQUENCY   20.0
+#define SWEEP_END_FREQUENCY     20000.0
+
+#define BLOCK_SIZE              256
+
+static gfloat sine_table[SINE_TABLE_SIZE];
+
+static gpointer
+init_sine_table (gpointer data)
+{
+        guint i;
+
+        for (i = 0; i < SINE_TABLE_SIZE; i++)
+                sine_table[i] = (gfloat) sin (2.0 * G_PI * i / SINE_TABLE_SIZE);
+
+        return NULL;
+}
+
+static guint32
+phase_increment (gdouble frequency)
+{
+        return (guint32) (frequency / GVC_TEST_SIGNAL_RATE * 4294967296.0);
+}
+
+static void
+generate_sine (gdouble frequency, gfloat *samples, gsize n_samples)
+{
+        guint32 phase = 0;
+        guint32 increment;
+        gsize   i;
+
+        increment = phase_increment (frequency);
+
+        for (i = 0; i < n_samples; i++) {
+                samples[i] = sine_table[phase >> (32 - SINE_TABLE_BITS)];
+                phase += increment;
+        }
+}
+
+/* Logarithmic sweep, the frequency grows by the same ratio each sample */
+static void
+generate_sweep (gfloat *samples, gsize n_samples)
+{
+        guint32 phase = 0;
+        gdouble frequency = SWEEP_START_FREQUENCY;
+        gdouble ratio;
+        gsize   i;
+
+        ratio = pow (SWEEP_END_FREQUENCY / SWEEP_START_FREQUENCY, 1.0 / n_samples);
+
+        for (i = 0; i < n_samples; i++) {
+                samples[i] = sine_table[phase >> (32 - SINE_TABLE_BITS)];
+                phase += phase_increment (frequency);
+                frequency *= ratio;
+        }
+}
+
+/* Pink noise from white noise using Paul Kellet's economy filter. The
+ * generator is seeded with a constant, so the signal is the same on
+ * every system. The white noise is produced a block at a time, which
+ * keeps the generator and filter loops simple enough to vectorize. */
+static void
+generate_pink_noise (gfloat *samples, gsize n_samples)
+{
+        gfloat  white[BLOCK_SIZE];
+        guint32 state = 0x9e3779b9;
+        gfloat  b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+        gfloat  peak = 0.0f;
+        gsize   offset;
+        gsize   i;
+
+        for (offset = 0; offset < n_samples; offset += BLOCK_SIZE) {
+                gsize count = MIN (BLOCK_SIZE, n_samples - offset);
+
+                for (i = 0; i < count; i++) {
+                        /* xorshift32 */
+                        state ^= state << 13;
+                        state ^= state >> 17;
+                        state ^= state << 5;
+                        white[i] = (gfloat) state / 2147483648.0f - 1.0f;
+                }
+
+                for (i = 0; i < count; i++) {
+                        b0 = 0.99765f * b0 + white[i] * 0.0990460f;
+                        b1 = 0.96300f * b1 + white[i] * 0.2965164f;
+                        b2 = 0.57000f * b2 + white[i] * 1.0526913f;
+                        samples[offset + i] = b0 + b1 + b2 + white[i] * 0.1848f;
+                }
+        }
+
+        for (i = 0; i < n_samples; i++)
+                peak = MAX (peak, fabsf (samples[i]));
+
+        if (peak > 0.0f) {
+                gfloat scale = 1.0f / peak;
+
+                for (i = 0; i < n_samples; i++)
+                        samples[i] *= scale;
+        }
+}
+
+/* Applies the output level and short fades so the signal starts and
+ * stops without clicks */
+static void
+shape_signal (gfloat *samples, gsize n_samples)
+{
+        gsize fade;
+        gsize i;
+
+        for (i = 0; i < n_samples; i++)
+                samples[i] *= SIGNAL_AMPLITUDE;
+
+        fade = MIN ((gsize) GVC_TEST_SIGNAL_RATE * SIGNAL_FADE_MS / 1000, n_samples / 2);
+        for (i = 0; i < fade; i++) {
+                gfloat gain = (gfloat) i / fade;
+
+                samples[i] *= gain;
+                samples[n_samples - 1 - i] *= gain;
+        }
+}
+
+/**
+ * gvc_test_signal_generate:
+ * @signal: the kind of signal
+ * @frequency: the frequency of a sine signal, ignored otherwise
+ * @samples: the buffer to fill
+ * @n_samples: the number of samples in @samples
+ *
+ * Fills @samples with a mono test signal at %GVC_TEST_SIGNAL_RATE.
+ */
+void
+gvc_test_signal_generate (GvcTestSignal  signal,
+                          gdouble        frequency,
+                          gfloat        *samples,
+                          gsize          n_samples)
+{
+        static GOnce once = G_ONCE_INIT;
+
+        g_return_if_fail (samples != NULL || n_samples == 0);
+
+        g_once (&once, init_sine_table, NULL);
+
+        switch (signal) {
+        case GVC_TEST_SIGNAL_SINE:
+                generate_sine (frequency, samples, n_samples);
+                break;
+        case GVC_TEST_SIGNAL_PINK_NOISE:
+                generate_pink_noise (samples, n_samples);
+                break;
+        case GVC_TEST_SIGNAL_SWEEP:
+                generate_sweep (samples, n_samples);
+                break;
+        default:
+                memset (samples, 0, n_samples * sizeof (gfloat));
+                return;
+        }
+
+        shape_signal (samples, n_samples);
+}
+
+static void
+append_le16 (GByteArray *array, guint16 value)
+{
+        guint8 data[2] = { value & 0xff, value >> 8 };
+
+        g_byte_array_append (array, data, sizeof (data));
+}
+
+static void
+append_le32 (GByteArray *array, guint32 value)
+{
+        guint8 data[4] = { value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, value >> 24 };
+
+        g_byte_array_append (array, data, sizeof (data));
+}
+
+/* Encodes the samples as a 16-bit mono PCM WAV file, which libcanberra
+ * reads without any real decoding */
+static GByteArray *
+encode_wav (const gfloat *samples, gsize n_samples)
+{
+        GByteArray *array;
+        guint32     data_size;
+        gsize       i;
+
+        data_size = n_samples * sizeof (gint16);
+
+        array = g_byte_array_sized_new (44 + data_size);
+
+        g_byte_array_append (array, (const guint8 *) "RIFF", 4);
+        append_le32 (array, 36 + data_size);
+        g_byte_array_append (array, (const guint8 *) "WAVE", 4);
+
+        g_byte_array_append (array, (const guint8 *) "fmt ", 4);
+        append_le32 (array, 16);
+        append_le16 (array, 1);                            /* PCM */
+        append_le16 (array, 1);                            /* channels */
+        append_le32 (array, GVC_TEST_SIGNAL_RATE);
+        append_le32 (array, GVC_TEST_SIGNAL_RATE * sizeof (gint16));
+        append_le16 (array, sizeof (gint16));              /* block align */
+        append_le16 (array, 16);                           /* bits per sample */
+
+        g_byte_array_append (array, (const guint8 *) "data", 4);
+        append_le32 (array, data_size);
+
+        for (i = 0; i < n_samples; i++) {
+                gfloat value = CLAMP (samples[i], -1.0f, 1.0f);
+
+                append_le16 (array, (guint16) (gint16) lrintf (value * 32767.0f));
+        }
+
+        return array;
+}
+
+/**
+ * gvc_test_signal_get_file:
+ * @signal: the kind of signal
+ * @frequency: the frequency of a sine signal, ignored otherwise
+ * @error: return location for an error
+ *
+ * Returns the path of a WAV file holding the given signal. The file is
+ * generated in the user runtime directory on first use and kept for the
+ * rest of the process, so that libcanberra can play it without a sound
+ * theme lookup.
+ *
+ * Returns: the path to the file, or %NULL on error
+ */
+const gchar *
+gvc_test_signal_get_file (GvcTestSignal   signal,
+                          gdouble         frequency,
+                          GError        **error)
+{
+        static GHashTable *files = NULL;
+        static const gchar *signal_names[] = {
+                [GVC_TEST_SIGNAL_SINE]       = "sine",
+                [GVC_TEST_SIGNAL_PINK_NOISE] = "pink-noise",
+                [GVC_TEST_SIGNAL_SWEEP]      = "sweep"
+        };
+        GByteArray *wav;
+        gfloat     *samples;
+        gsize       n_samples;
+        gchar      *name;
+        gchar      *path;
+        gboolean    success;
+
+        g_return_val_if_fail (signal <= GVC_TEST_SIGNAL_SWEEP, NULL);
+
+        if (signal != GVC_TEST_SIGNAL_SINE)
+                frequency = 0.0;
+
+        name = g_strdup_printf ("mate-volume-control-%s-%u.wav",
+                                signal_names[signal],
+                                (guint) frequency);
+
+        if (files == NULL)
+                files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+        path = g_hash_table_lookup (files, name);
+        if (path != NULL) {
+                g_free (name);
+                return path;
+        }
+
+        n_samples = (gsize) GVC_TEST_SIGNAL_RATE * GVC_TEST_SIGNAL_DURATION_MS / 1000;
+        samples = g_new (gfloat, n_samples);
+
+        gvc_test_signal_generate (signal, frequency, samples, n_samples);
+
+        wav = encode_wav (samples, n_samples);
+        g_free (samples);
+
+        path = g_build_filename (g_get_user_runtime_dir (), name, NULL);
+
+        success = g_file_set_contents (path, (const gchar *) wav->data, wav->len, error);
+        g_byte_array_unref (wav);
+
+        if (success == FALSE) {
+                g_free (name);
+                g_free (path);
+                return NULL;
+        }
+
+        g_hash_table_insert (files, name, path);
+
+        return path;
+}
@@ -0,0 +1,48 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __GVC_TEST_SIGNAL_H
+#define __GVC_TEST_SIGNAL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define GVC_TEST_SIGNAL_RATE            48000
+#define GVC_TEST_SIGNAL_DURATION_MS     1000
+
+typedef enum {
+        GVC_TEST_SIGNAL_SINE,
+        GVC_TEST_SIGNAL_PINK_NOISE,
+        GVC_TEST_SIGNAL_SWEEP
+} GvcTestSignal;
+
+void         gvc_test_signal_generate (GvcTestSignal  signal,
+                                       gdouble        frequency,
+                                       gfloat        *samples,
+                                       gsize          n_samples);
+
+const gchar *gvc_test_signal_get_file (GvcTestSignal  signal,
+                                       gdouble        frequency,
+                                       GError       **error);
+
+G_END_DECLS
+
+#endif /* __GVC_TEST_SIGNAL_H */
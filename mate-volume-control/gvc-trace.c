@@ -0,0 +1,344 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <glib-object.h>
+
+#include "gvc-trace.h"
+
+/* Environment variable which turns on the tracing of the signal handlers,
+ * the statistics are printed when the process receives SIGUSR1 */
+#define TRACE_ENV               "MATE_VOLUME_CONTROL_TRACE"
+
+static gboolean      trace_enabled = FALSE;
+static GvcTraceSite *trace_sites = NULL;
+static GHashTable   *trace_instances = NULL;
+
+/* Signal handlers connected to the watched instances of a type */
+typedef struct
+{
+        const gchar *name;
+        guint        instances;
+        guint        handlers;
+} TraceHandlers;
+
+static gboolean
+on_dump_signal (gpointer data)
+{
+        gvc_trace_dump ();
+
+        return G_SOURCE_CONTINUE;
+}
+
+void
+gvc_trace_init (void)
+{
+        if (trace_enabled == TRUE || g_getenv (TRACE_ENV) == NULL)
+                return;
+
+        trace_enabled = TRUE;
+
+        g_unix_signal_add (SIGUSR1, on_dump_signal, NULL);
+}
+
+/* Returns 0 when tracing is disabled, so that the scope ends cheaply */
+gint64
+gvc_trace_begin (void)
+{
+        if (trace_enabled == FALSE)
+                return 0;
+
+        return g_get_monotonic_time ();
+}
+
+void
+gvc_trace_scope_end (GvcTraceScope *scope)
+{
+        GvcTraceSite *site = scope->site;
+        gint64        elapsed;
+
+        if (scope->start == 0)
+                return;
+
+        elapsed = g_get_monotonic_time () - scope->start;
+
+        if (site->name == NULL) {
+                site->name = scope->name;
+                site->next = trace_sites;
+                trace_sites = site;
+        }
+
+        site->calls++;
+        site->total += elapsed;
+        if (elapsed > site->max)
+                site->max = elapsed;
+}
+
+static gint
+compare_sites (gconstpointer a, gconstpointer b)
+{
+        const GvcTraceSite *site_a = *(const GvcTraceSite **) a;
+        const GvcTraceSite *site_b = *(const GvcTraceSite **) b;
+
+        if (site_a->total != site_b->total)
+                return (site_a->total < site_b->total) ? 1 : -1;
+
+        return g_strcmp0 (site_a->name, site_b->name);
+}
+
+/* Prints the resident memory of the process as reported by Linux */
+static void
+dump_memory (void)
+{
+        gchar  *contents;
+        gulong  size;
+        gulong  resident;
+
+        if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL) == FALSE)
+                return;
+
+        if (sscanf (contents, "%lu %lu", &size, &resident) == 2)
+                g_printerr ("Resident memory: %lu kB\n", resident * (sysconf (_SC_PAGESIZE) / 1024));
+
+        g_free (contents);
+}
+
+/* Prints the number of live instances of our and libmatemixer types, which
+ * is only counted with GOBJECT_DEBUG=instance-count, and adds up the
+ * widgets of any type */
+static void
+dump_instance_counts (GType type, GType widget_type, guint *n_widgets)
+{
+        GType *children;
+        guint  n_children;
+        guint  i;
+        gint   count;
+
+        count = g_type_get_instance_count (type);
+        if (count > 0 &&
+            (g_str_has_prefix (g_type_name (type), "Gvc") ||
+             g_str_has_prefix (g_type_name (type), "MateMixer")))
+                g_printerr ("%10d  %s\n", count, g_type_name (type));
+
+        if (count > 0 && widget_type != G_TYPE_INVALID && g_type_is_a (type, widget_type))
+                *n_widgets += count;
+
+        children = g_type_children (type, &n_children);
+        for (i = 0; i < n_children; i++)
+                dump_instance_counts (children[i], widget_type, n_widgets);
+
+        g_free (children);
+}
+
+static void
+on_watched_instance_finalized (gpointer data, GObject *where_the_object_was)
+{
+        g_hash_table_remove (trace_instances, where_the_object_was);
+}
+
+/**
+ * gvc_trace_watch:
+ * @instance: (nullable): a #GObject
+ *
+ * Includes the signal handlers connected to @instance in the dump, until
+ * the instance is finalized. Does nothing when tracing is disabled or
+ * @instance is %NULL.
+ */
+void
+gvc_trace_watch (gpointer instance)
+{
+        if (trace_enabled == FALSE || instance == NULL)
+                return;
+
+        g_return_if_fail (G_IS_OBJECT (instance));
+
+        if (trace_instances == NULL)
+                trace_instances = g_hash_table_new (NULL, NULL);
+
+        if (g_hash_table_add (trace_instances, instance) == TRUE)
+                g_object_weak_ref (G_OBJECT (instance), on_watched_instance_finalized, NULL);
+}
+
+/* GLib has no way to list the handlers of an instance, but blocking the
+ * handlers of a signal returns how many there are; they are unblocked
+ * again right away, which leaves the blocked ones blocked */
+static guint
+count_signal_handlers (gpointer instance, GType type)
+{
+        guint *ids;
+        guint  n_ids;
+        guint  count = 0;
+        guint  i;
+
+        ids = g_signal_list_ids (type, &n_ids);
+
+        for (i = 0; i < n_ids; i++) {
+                guint n;
+
+                n = g_signal_handlers_block_matched (instance,
+                                                     G_SIGNAL_MATCH_ID,
+                                                     ids[i], 0,
+                                                     NULL, NULL, NULL);
+                if (n > 0)
+                        g_signal_handlers_unblock_matched (instance,
+                                                           G_SIGNAL_MATCH_ID,
+                                                           ids[i], 0,
+                                                           NULL, NULL, NULL);
+                count += n;
+        }
+        g_free (ids);
+
+        return count;
+}
+
+static guint
+count_handlers (gpointer instance)
+{
+        GType *interfaces;
+        GType  type;
+        guint  n_interfaces;
+        guint  count = 0;
+        guint  i;
+
+        for (type = G_OBJECT_TYPE (instance); type != 0; type = g_type_parent (type))
+                count += count_signal_handlers (instance, type);
+
+        interfaces = g_type_interfaces (G_OBJECT_TYPE (instance), &n_interfaces);
+        for (i = 0; i < n_interfaces; i++)
+                count += count_signal_handlers (instance, interfaces[i]);
+
+        g_free (interfaces);
+
+        return count;
+}
+
+static gint
+compare_handlers (gconstpointer a, gconstpointer b)
+{
+        const TraceHandlers *handlers_a = *(const TraceHandlers **) a;
+        const TraceHandlers *handlers_b = *(const TraceHandlers **) b;
+
+        if (handlers_a->handlers != handlers_b->handlers)
+                return (handlers_a->handlers < handlers_b->handlers) ? 1 : -1;
+
+        return g_strcmp0 (handlers_a->name, handlers_b->name);
+}
+
+/* Prints the signal handlers connected to the watched instances, added up
+ * per type, handlers which are never disconnected show up as growth */
+static void
+dump_handler_counts (void)
+{
+        GHashTable     *types;
+        GHashTableIter  iter;
+        GPtrArray      *rows;
+        gpointer        instance;
+        TraceHandlers  *row;
+        guint           i;
+
+        if (trace_instances == NULL)
+                return;
+
+        types = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+
+        g_hash_table_iter_init (&iter, trace_instances);
+        while (g_hash_table_iter_next (&iter, &instance, NULL)) {
+                const gchar *name = G_OBJECT_TYPE_NAME (instance);
+
+                row = g_hash_table_lookup (types, name);
+                if (row == NULL) {
+                        row = g_new0 (TraceHandlers, 1);
+                        row->name = name;
+                        g_hash_table_insert (types, (gpointer) name, row);
+                }
+                row->instances++;
+                row->handlers += count_handlers (instance);
+        }
+
+        rows = g_ptr_array_new ();
+
+        g_hash_table_iter_init (&iter, types);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &row))
+                g_ptr_array_add (rows, row);
+
+        g_ptr_array_sort (rows, compare_handlers);
+
+        g_printerr ("%10s %10s  %s\n", "Handlers", "Instances", "Watched type");
+
+        for (i = 0; i < rows->len; i++) {
+                row = g_ptr_array_index (rows, i);
+
+                g_printerr ("%10u %10u  %s\n", row->handlers, row->instances, row->name);
+        }
+
+        g_ptr_array_unref (rows);
+        g_hash_table_destroy (types);
+}
+
+/* Prints the traced functions, the most expensive one first, followed by
+ * the memory use and the connected signal handlers so that growth is
+ * visible across dumps */
+void
+gvc_trace_dump (void)
+{
+        GPtrArray    *sites;
+        GvcTraceSite *site;
+        guint         n_widgets = 0;
+        guint         i;
+
+        sites = g_ptr_array_new ();
+
+        for (site = trace_sites; site != NULL; site = site->next)
+                g_ptr_array_add (sites, site);
+
+        g_ptr_array_sort (sites, compare_sites);
+
+        g_printerr ("%10s %12s %10s %10s  %s\n",
+                    "Calls", "Total (ms)", "Avg (us)", "Max (us)", "Function");
+
+        for (i = 0; i < sites->len; i++) {
+                site = g_ptr_array_index (sites, i);
+
+                g_printerr ("%10u %12.1f %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT "  %s\n",
+                            site->calls,
+                            site->total / 1000.0,
+                            site->total / site->calls,
+                            site->max,
+                            site->name);
+        }
+
+        g_ptr_array_free (sites, TRUE);
+
+        dump_memory ();
+
+        g_printerr ("%10s  %s\n", "Instances", "Type");
+        dump_instance_counts (G_TYPE_OBJECT, g_type_from_name ("GtkWidget"), &n_widgets);
+
+        g_printerr ("%10u  %s\n", n_widgets, "Widgets in total");
+
+        dump_handler_counts ();
+}
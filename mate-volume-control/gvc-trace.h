@@ -0,0 +1,66 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __GVC_TRACE_H
+#define __GVC_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Statistics of a traced function, the handlers run in the main thread
+ * so the counters are not locked */
+typedef struct _GvcTraceSite GvcTraceSite;
+
+struct _GvcTraceSite
+{
+        const gchar  *name;
+        guint         calls;
+        gint64        total;
+        gint64        max;
+        GvcTraceSite *next;
+};
+
+typedef struct
+{
+        GvcTraceSite *site;
+        const gchar  *name;
+        gint64        start;
+} GvcTraceScope;
+
+void        gvc_trace_init          (void);
+gint64      gvc_trace_begin         (void);
+void        gvc_trace_scope_end     (GvcTraceScope *scope);
+void        gvc_trace_dump          (void);
+void        gvc_trace_watch         (gpointer       instance);
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (GvcTraceScope, gvc_trace_scope_end)
+
+/* Records the time spent in the enclosing function until it returns, it
+ * must come first in the function body */
+#define GVC_TRACE_FUNCTION()                                                    \
+        static GvcTraceSite gvc_trace_site;                                     \
+        g_auto (GvcTraceScope) gvc_trace_scope = {                              \
+                &gvc_trace_site, G_STRFUNC, gvc_trace_begin ()                  \
+        }
+
+G_END_DECLS
+
+#endif /* __GVC_TRACE_H */
@@ -28,6 +28,14 @@
 
 #include "gvc-utils.h"
 
+/* Environment variable which turns on the startup profile, the same as
+ * the --profile-startup option */
+#define STARTUP_PROFILE_ENV     "MATE_VOLUME_CONTROL_PROFILE_STARTUP"
+
+static gint64   startup_time = 0;
+static gint64   startup_last = 0;
+static gboolean startup_profile = FALSE;
+
 /* libcanberra requires a PulseAudio channel name to be given to its
  * CA_PROP_CANBERRA_FORCE_CHANNEL property.
  *
@@ -157,3 +165,45 @@ gvc_channel_map_to_pretty_string (MateMixerStreamControl *control)
 
         return NULL;
 }
+
+/* Records the start of the process, to be called first in main() */
+void
+gvc_startup_profile_init (void)
+{
+        startup_time =
+        startup_last = g_get_monotonic_time ();
+
+        if (g_getenv (STARTUP_PROFILE_ENV) != NULL)
+                gvc_startup_profile_enable ();
+}
+
+void
+gvc_startup_profile_enable (void)
+{
+        if (startup_profile == TRUE)
+                return;
+
+        startup_profile = TRUE;
+
+        g_printerr ("%-32s %10s %10s\n", "Startup phase", "Step (ms)", "Total (ms)");
+}
+
+/* Prints the time taken since the previous phase and since the start
+ * of the process, when the startup profile is enabled */
+void
+gvc_startup_profile_mark (const gchar *phase)
+{
+        gint64 now;
+
+        if (startup_profile == FALSE)
+                return;
+
+        now = g_get_monotonic_time ();
+
+        g_printerr ("%-32s %10.1f %10.1f\n",
+                    phase,
+                    (now - startup_last) / 1000.0,
+                    (now - startup_time) / 1000.0);
+
+        startup_last = now;
+}
@@ -32,6 +32,10 @@ const gchar *gvc_channel_position_to_pulse_string  (MateMixerChannelPosition pos
 const gchar *gvc_channel_position_to_pretty_string (MateMixerChannelPosition position);
 const gchar *gvc_channel_map_to_pretty_string      (MateMixerStreamControl  *control);
 
+void         gvc_startup_profile_init              (void);
+void         gvc_startup_profile_enable            (void);
+void         gvc_startup_profile_mark              (const gchar             *phase);
+
 G_END_DECLS
 
 #endif /* __GVC_HELPERS_H */
@@ -18,17 +18,31 @@
  * 02110-1301, USA.
  */
 
+#define _GNU_SOURCE
+
 #include <config.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <glib/gstdio.h>
 #include <glib/gi18n.h>
 #include <gio/gio.h>
 #include <utime.h>
 #include <strings.h>
+#include <string.h>
+#include <errno.h>
 
 #include "sound-theme-file-utils.h"
 
 #define CUSTOM_THEME_NAME       "__custom"
 
+/* Hidden directory of the custom theme holding imported sound files, the
+ * theme links to them the same way as to the alerts picked in the chooser */
+#define IMPORTED_SOUNDS_DIR     ".imported"
+
+/* Prefix of the hidden directories the custom theme is staged in */
+#define STAGING_DIR_PREFIX      "." CUSTOM_THEME_NAME "."
+
 /* This function needs to be called after each individual
  * changeset to the theme */
 void
@@ -142,19 +156,16 @@ delete_custom_theme_dir (void)
         g_debug ("deleted the custom theme dir");
 }
 
-gboolean
-custom_theme_dir_is_empty (void)
+static gboolean
+theme_dir_is_empty (const char *dir)
 {
-        char            *dir;
         GFile           *file;
         gboolean         is_empty;
         GFileEnumerator *enumerator;
         GFileInfo       *info;
         GError          *error = NULL;
 
-        dir = custom_theme_dir_path (NULL);
         file = g_file_new_for_path (dir);
-        g_free (dir);
 
         is_empty = TRUE;
 
@@ -172,13 +183,15 @@ custom_theme_dir_is_empty (void)
         while (is_empty &&
                (info = g_file_enumerator_next_file (enumerator, NULL, NULL))) {
 
-                if (strcmp ("index.theme", g_file_info_get_name (info)) != 0) {
+                if (strcmp ("index.theme", g_file_info_get_name (info)) != 0 &&
+                    strcmp (IMPORTED_SOUNDS_DIR, g_file_info_get_name (info)) != 0) {
                         is_empty = FALSE;
                 }
 
                 g_object_unref (info);
         }
         g_file_enumerator_close (enumerator, NULL, NULL);
+        g_object_unref (enumerator);
 
  out:
         g_object_unref (file);
@@ -186,14 +199,38 @@ custom_theme_dir_is_empty (void)
         return is_empty;
 }
 
+gboolean
+custom_theme_dir_is_empty (void)
+{
+        char     *dir;
+        gboolean  is_empty;
+
+        dir = custom_theme_dir_path (NULL);
+        is_empty = theme_dir_is_empty (dir);
+        g_free (dir);
+
+        return is_empty;
+}
+
+/* A transaction stages every change to the custom theme in a private
+ * sibling directory, which is then atomically exchanged with the live
+ * theme, so that libcanberra never sees a half-written or missing theme
+ * and only gets to reload it once per change. */
+struct _CustomThemeTransaction
+{
+        char *staging_dir;
+};
+
 static void
-delete_one_file (const char *sound_name, const char *file_extension)
+delete_one_file (const char *dir,
+                 const char *sound_name,
+                 const char *file_extension)
 {
         GFile *file;
         char *name, *filename;
 
         name = g_strconcat (sound_name, file_extension, NULL);
-        filename = custom_theme_dir_path (name);
+        filename = g_build_filename (dir, name, NULL);
         g_free (name);
         file = g_file_new_for_path (filename);
         g_free (filename);
@@ -201,48 +238,235 @@ delete_one_file (const char *sound_name, const char *file_extension)
         g_object_unref (file);
 }
 
-void
-delete_old_files (const char **sounds)
+static void
+create_one_file (GFile *file)
 {
-        guint i;
+        GFileOutputStream* stream;
 
-        for (i = 0; sounds[i] != NULL; i++) {
-                delete_one_file (sounds[i], ".ogg");
+        stream = g_file_create (file, G_FILE_CREATE_NONE, NULL, NULL);
+        if (stream != NULL) {
+                g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, NULL);
+                g_object_unref (stream);
         }
 }
 
-void
-delete_disabled_files (const char **sounds)
+static void
+write_index_theme (const char *dir, const char *parent)
 {
-        guint i;
+        GKeyFile *keyfile;
+        char     *data;
+        char     *path;
 
-        for (i = 0; sounds[i] != NULL; i++)
-                delete_one_file (sounds[i], ".disabled");
+        /* Set the data for index.theme */
+        keyfile = g_key_file_new ();
+        g_key_file_set_string (keyfile, "Sound Theme", "Name", _("Custom"));
+        g_key_file_set_string (keyfile, "Sound Theme", "Inherits", parent);
+        g_key_file_set_string (keyfile, "Sound Theme", "Directories", ".");
+        data = g_key_file_to_data (keyfile, NULL, NULL);
+        g_key_file_free (keyfile);
+
+        /* Save the index.theme */
+        path = g_build_filename (dir, "index.theme", NULL);
+        g_file_set_contents (path, data, -1, NULL);
+        g_free (path);
+        g_free (data);
 }
 
+/* Brings the files of the live custom theme into the staging directory.
+ *
+ * The files are hard linked rather than copied as the staged changes never
+ * modify a file in place: sounds are unlinked before being replaced and
+ * index.theme is written to a new file and renamed. Symbolic links are
+ * linked as links, copying is only a fallback for file systems without
+ * hard links. */
 static void
-create_one_file (GFile *file)
+copy_theme_files (const char *src_dir, const char *dest_dir)
 {
-        GFileOutputStream* stream;
+        GDir       *d;
+        const char *name;
 
-        stream = g_file_create (file, G_FILE_CREATE_NONE, NULL, NULL);
-        if (stream != NULL) {
-                g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, NULL);
-                g_object_unref (stream);
+        d = g_dir_open (src_dir, 0, NULL);
+        if (d == NULL)
+                return;
+
+        while ((name = g_dir_read_name (d)) != NULL) {
+                GFile  *src;
+                GFile  *dest;
+                char   *path;
+                char   *dest_path;
+                GError *error = NULL;
+
+                path = g_build_filename (src_dir, name, NULL);
+                dest_path = g_build_filename (dest_dir, name, NULL);
+
+                if (strcmp (name, IMPORTED_SOUNDS_DIR) == 0) {
+                        g_mkdir (dest_path, 0755);
+                        copy_theme_files (path, dest_path);
+                        g_free (dest_path);
+                        g_free (path);
+                        continue;
+                }
+
+                if (linkat (AT_FDCWD, path, AT_FDCWD, dest_path, 0) == 0) {
+                        g_free (dest_path);
+                        g_free (path);
+                        continue;
+                }
+
+                src = g_file_new_for_path (path);
+                g_free (path);
+
+                dest = g_file_new_for_path (dest_path);
+                g_free (dest_path);
+
+                if (g_file_copy (src, dest,
+                                 G_FILE_COPY_NOFOLLOW_SYMLINKS,
+                                 NULL, NULL, NULL, &error) == FALSE) {
+                        g_warning ("Unable to copy '%s': %s", name, error->message);
+                        g_error_free (error);
+                }
+                g_object_unref (src);
+                g_object_unref (dest);
+        }
+
+        g_dir_close (d);
+}
+
+/* Removes the staging directories left behind by a transaction which was
+ * interrupted, or by a previous theme which could not be deleted */
+static void
+delete_stale_staging_dirs (const char *sounds_dir)
+{
+        GDir       *d;
+        const char *name;
+
+        d = g_dir_open (sounds_dir, 0, NULL);
+        if (d == NULL)
+                return;
+
+        while ((name = g_dir_read_name (d)) != NULL) {
+                GFile *file;
+                char  *path;
+
+                if (g_str_has_prefix (name, STAGING_DIR_PREFIX) == FALSE)
+                        continue;
+
+                path = g_build_filename (sounds_dir, name, NULL);
+                file = g_file_new_for_path (path);
+                g_free (path);
+
+                capplet_file_delete_recursive (file, NULL);
+                g_object_unref (file);
+        }
+
+        g_dir_close (d);
+}
+
+static CustomThemeTransaction *
+custom_theme_transaction_new (gboolean copy_current)
+{
+        CustomThemeTransaction *transaction;
+        char                   *path;
+        char                   *template;
+        char                   *sounds_dir;
+
+        path = custom_theme_dir_path (NULL);
+
+        /* Stage next to the theme, so that publishing it is a rename
+         * within the same file system. The staging directory is hidden,
+         * theme lists skip it even though it contains an index.theme */
+        sounds_dir = g_path_get_dirname (path);
+        g_mkdir_with_parents (sounds_dir, 0755);
+        delete_stale_staging_dirs (sounds_dir);
+
+        template = g_build_filename (sounds_dir, STAGING_DIR_PREFIX "XXXXXX", NULL);
+        g_free (sounds_dir);
+        if (g_mkdtemp_full (template, 0755) == NULL) {
+                g_warning ("Failed to create directory '%s': %s",
+                           template, g_strerror (errno));
+                g_free (template);
+                g_free (path);
+                return NULL;
+        }
+
+        if (copy_current)
+                copy_theme_files (path, template);
+        g_free (path);
+
+        transaction = g_new0 (CustomThemeTransaction, 1);
+        transaction->staging_dir = template;
+
+        return transaction;
+}
+
+/**
+ * custom_theme_transaction_begin :
+ * @parent : the theme to inherit from, or %NULL to keep the parent of
+ *           the existing custom theme
+ *
+ * Starts a changeset to the custom theme, the changes only become
+ * visible once custom_theme_transaction_commit() is called.
+ **/
+CustomThemeTransaction *
+custom_theme_transaction_begin (const char *parent)
+{
+        CustomThemeTransaction *transaction;
+
+        transaction = custom_theme_transaction_new (TRUE);
+
+        if (transaction != NULL && parent != NULL)
+                write_index_theme (transaction->staging_dir, parent);
+
+        return transaction;
+}
+
+gboolean
+custom_theme_transaction_is_empty (CustomThemeTransaction *transaction)
+{
+        g_return_val_if_fail (transaction != NULL, TRUE);
+
+        return theme_dir_is_empty (transaction->staging_dir);
+}
+
+void
+custom_theme_transaction_delete_old_files (CustomThemeTransaction *transaction,
+                                           const char            **sounds)
+{
+        guint i;
+
+        g_return_if_fail (transaction != NULL);
+
+        for (i = 0; sounds[i] != NULL; i++) {
+                delete_one_file (transaction->staging_dir, sounds[i], ".ogg");
         }
 }
 
 void
-add_disabled_file (const char **sounds)
+custom_theme_transaction_delete_disabled_files (CustomThemeTransaction *transaction,
+                                                const char            **sounds)
+{
+        guint i;
+
+        g_return_if_fail (transaction != NULL);
+
+        for (i = 0; sounds[i] != NULL; i++)
+                delete_one_file (transaction->staging_dir, sounds[i], ".disabled");
+}
+
+void
+custom_theme_transaction_add_disabled_file (CustomThemeTransaction *transaction,
+                                            const char            **sounds)
 {
         guint i;
 
+        g_return_if_fail (transaction != NULL);
+
         for (i = 0; sounds[i] != NULL; i++) {
                 GFile *file;
                 char *name, *filename;
 
                 name = g_strdup_printf ("%s.disabled", sounds[i]);
-                filename = custom_theme_dir_path (name);
+                filename = g_build_filename (transaction->staging_dir, name, NULL);
                 g_free (name);
                 file = g_file_new_for_path (filename);
                 g_free (filename);
@@ -253,10 +477,14 @@ add_disabled_file (const char **sounds)
 }
 
 void
-add_custom_file (const char **sounds, const char *filename)
+custom_theme_transaction_add_custom_file (CustomThemeTransaction *transaction,
+                                          const char            **sounds,
+                                          const char             *filename)
 {
         guint i;
 
+        g_return_if_fail (transaction != NULL);
+
         for (i = 0; sounds[i] != NULL; i++) {
                 GFile *file;
                 char *name, *path;
@@ -264,7 +492,7 @@ add_custom_file (const char **sounds, const char *filename)
                 /* We use *.ogg because it's the first type of file that
                  * libcanberra looks at */
                 name = g_strdup_printf ("%s.ogg", sounds[i]);
-                path = custom_theme_dir_path (name);
+                path = g_build_filename (transaction->staging_dir, name, NULL);
                 g_free (name);
                 /* In case there's already a link there, delete it */
                 g_unlink (path);
@@ -277,31 +505,679 @@ add_custom_file (const char **sounds, const char *filename)
         }
 }
 
-void
-create_custom_theme (const char *parent)
+static void
+set_move_error (GError **error, const char *path, int saved_errno)
 {
-        GKeyFile *keyfile;
-        char     *data;
-        char     *path;
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                     "Failed to move '%s': %s", path, g_strerror (saved_errno));
+}
+
+/* Puts the staged theme in place of the live one and returns the directory
+ * which now holds the previous theme in @old_dir, or %NULL if there was none.
+ *
+ * Where the system supports it, the two directories are exchanged in a single
+ * step so that there is no moment without a custom theme. Otherwise the live
+ * theme has to be moved out of the way first as a directory cannot be renamed
+ * over a non-empty one. */
+static gboolean
+exchange_theme_dirs (const char  *staging_dir,
+                     const char  *path,
+                     char       **old_dir,
+                     GError     **error)
+{
+        char *old_path;
+
+        *old_dir = NULL;
+
+#ifdef HAVE_RENAMEAT2
+        if (renameat2 (AT_FDCWD, staging_dir,
+                       AT_FDCWD, path,
+                       RENAME_EXCHANGE) == 0) {
+                *old_dir = g_strdup (staging_dir);
+                return TRUE;
+        }
+
+        /* Fall back to renaming if there is no live theme yet or if the file
+         * system does not support exchanging */
+        if (errno != ENOENT && errno != EINVAL && errno != ENOSYS) {
+                set_move_error (error, staging_dir, errno);
+                return FALSE;
+        }
+#endif
+
+        old_path = g_strconcat (staging_dir, ".old", NULL);
+
+        if (g_rename (path, old_path) != 0) {
+                if (errno != ENOENT) {
+                        set_move_error (error, path, errno);
+                        g_free (old_path);
+                        return FALSE;
+                }
+                g_clear_pointer (&old_path, g_free);
+        }
+
+        if (g_rename (staging_dir, path) != 0) {
+                set_move_error (error, staging_dir, errno);
+
+                /* Put the previous theme back */
+                if (old_path != NULL) {
+                        g_rename (old_path, path);
+                        g_free (old_path);
+                }
+                return FALSE;
+        }
+
+        *old_dir = old_path;
+        return TRUE;
+}
+
+/**
+ * custom_theme_transaction_commit :
+ * @transaction :
+ * @error  :
+ *
+ * Replaces the custom theme with the staged one. The transaction
+ * still needs to be freed afterwards.
+ **/
+gboolean
+custom_theme_transaction_commit (CustomThemeTransaction *transaction,
+                                 GError                **error)
+{
+        char *path;
+        char *old_dir;
+
+        g_return_val_if_fail (transaction != NULL, FALSE);
+        g_return_val_if_fail (transaction->staging_dir != NULL, FALSE);
 
-        /* Create the custom directory */
         path = custom_theme_dir_path (NULL);
-        g_mkdir_with_parents (path, 0755);
+
+        if (exchange_theme_dirs (transaction->staging_dir,
+                                 path,
+                                 &old_dir,
+                                 error) == FALSE) {
+                g_free (path);
+                return FALSE;
+        }
         g_free (path);
 
-        /* Set the data for index.theme */
-        keyfile = g_key_file_new ();
-        g_key_file_set_string (keyfile, "Sound Theme", "Name", _("Custom"));
-        g_key_file_set_string (keyfile, "Sound Theme", "Inherits", parent);
-        g_key_file_set_string (keyfile, "Sound Theme", "Directories", ".");
-        data = g_key_file_to_data (keyfile, NULL, NULL);
-        g_key_file_free (keyfile);
+        g_clear_pointer (&transaction->staging_dir, g_free);
 
-        /* Save the index.theme */
-        path = custom_theme_dir_path ("index.theme");
-        g_file_set_contents (path, data, -1, NULL);
-        g_free (path);
-        g_free (data);
+        if (old_dir != NULL) {
+                GFile *file;
+
+                file = g_file_new_for_path (old_dir);
+                capplet_file_delete_recursive (file, NULL);
+                g_object_unref (file);
+                g_free (old_dir);
+        }
 
         custom_theme_update_time ();
+
+        return TRUE;
+}
+
+/**
+ * custom_theme_transaction_free :
+ * @transaction :
+ *
+ * Frees the transaction, discarding any uncommitted changes.
+ **/
+void
+custom_theme_transaction_free (CustomThemeTransaction *transaction)
+{
+        if (transaction == NULL)
+                return;
+
+        if (transaction->staging_dir != NULL) {
+                GFile *file;
+
+                file = g_file_new_for_path (transaction->staging_dir);
+                capplet_file_delete_recursive (file, NULL);
+                g_object_unref (file);
+                g_free (transaction->staging_dir);
+        }
+        g_free (transaction);
+}
+
+#define OGG_PAGE_HEADER_SIZE    27
+#define OGG_MAX_PAGE_SIZE       (OGG_PAGE_HEADER_SIZE + 255 + 255 * 255)
+#define OPUS_GRANULE_RATE       48000
+
+static guint32
+read_le32 (const guint8 *p)
+{
+        return (guint32) p[0] | ((guint32) p[1] << 8) | ((guint32) p[2] << 16) | ((guint32) p[3] << 24);
+}
+
+static guint64
+read_le64 (const guint8 *p)
+{
+        return (guint64) read_le32 (p) | ((guint64) read_le32 (p + 4) << 32);
+}
+
+static gboolean
+is_ogg_page (const guint8 *p, gsize len)
+{
+        return len >= OGG_PAGE_HEADER_SIZE && memcmp (p, "OggS", 4) == 0 && p[4] == 0;
+}
+
+/* Returns the granule position of the last page of the logical stream,
+ * looking only at the tail of the file */
+static gboolean
+find_last_granule (const guint8 *data, gsize len, guint32 serial, guint64 *granule)
+{
+        gsize start;
+        gsize pos;
+
+        if (len < OGG_PAGE_HEADER_SIZE)
+                return FALSE;
+
+        start = len > OGG_MAX_PAGE_SIZE ? len - OGG_MAX_PAGE_SIZE : 0;
+
+        for (pos = len - OGG_PAGE_HEADER_SIZE + 1; pos-- > start; ) {
+                const guint8 *page = data + pos;
+
+                if (!is_ogg_page (page, len - pos))
+                        continue;
+                if (read_le32 (page + 14) != serial)
+                        continue;
+
+                *granule = read_le64 (page + 6);
+
+                /* -1 means that no packet finishes on this page */
+                if (*granule != G_MAXUINT64)
+                        return TRUE;
+        }
+        return FALSE;
+}
+
+/**
+ * sound_file_probe_header :
+ * @filename : an Ogg Vorbis or Ogg Opus file
+ * @channels : return location for the channel count
+ * @rate : return location for the sample rate
+ * @duration_ms : return location for the duration in milliseconds
+ *
+ * Reads the stream parameters from the identification header and the
+ * duration from the granule position of the last page, without decoding
+ * anything. The file is mapped so that only the pages looked at are
+ * actually read.
+ **/
+gboolean
+sound_file_probe_header (const char *filename,
+                         guint      *channels,
+                         guint      *rate,
+                         guint64    *duration_ms)
+{
+        GMappedFile  *mapped;
+        const guint8 *data;
+        const guint8 *packet;
+        gsize         len;
+        gsize         offset;
+        guint32       serial;
+        guint64       granule;
+        guint64       granule_rate;
+        guint64       pre_skip = 0;
+        gboolean      success = FALSE;
+
+        mapped = g_mapped_file_new (filename, FALSE, NULL);
+        if (mapped == NULL)
+                return FALSE;
+
+        data = (const guint8 *) g_mapped_file_get_contents (mapped);
+        len = g_mapped_file_get_length (mapped);
+
+        if (data == NULL || !is_ogg_page (data, len))
+                goto out;
+
+        /* The identification header is alone on the first page */
+        offset = OGG_PAGE_HEADER_SIZE + data[26];
+        if (offset + 19 > len)
+                goto out;
+
+        serial = read_le32 (data + 14);
+        packet = data + offset;
+
+        if (packet[0] == 0x01 && memcmp (packet + 1, "vorbis", 6) == 0) {
+                *channels = packet[11];
+                *rate = read_le32 (packet + 12);
+                granule_rate = *rate;
+        } else if (memcmp (packet, "OpusHead", 8) == 0) {
+                *channels = packet[9];
+                *rate = read_le32 (packet + 12);
+                pre_skip = (guint64) packet[10] | ((guint64) packet[11] << 8);
+                granule_rate = OPUS_GRANULE_RATE;
+
+                /* The input rate is informational only and may be unset */
+                if (*rate == 0)
+                        *rate = OPUS_GRANULE_RATE;
+        } else {
+                goto out;
+        }
+
+        if (*channels == 0 || granule_rate == 0)
+                goto out;
+
+        if (find_last_granule (data, len, serial, &granule) && granule > pre_skip)
+                *duration_ms = (granule - pre_skip) * 1000 / granule_rate;
+        else
+                *duration_ms = 0;
+
+        success = TRUE;
+ out:
+        g_mapped_file_unref (mapped);
+
+        return success;
+}
+
+/* The custom theme is exported as a POSIX ustar archive, which can be
+ * streamed in a single pass and unpacked with standard tools */
+#define TAR_BLOCK_SIZE          512
+
+/* Limits of an imported archive, the sound files of a theme are short
+ * alerts and a hostile archive must not be able to fill the disk */
+#define IMPORT_MAX_FILE_SIZE    (8 * 1024 * 1024)
+#define IMPORT_MAX_TOTAL_SIZE   (128 * 1024 * 1024)
+
+typedef struct
+{
+        char name[100];
+        char mode[8];
+        char uid[8];
+        char gid[8];
+        char size[12];
+        char mtime[12];
+        char checksum[8];
+        char typeflag;
+        char linkname[100];
+        char magic[6];
+        char version[2];
+        char uname[32];
+        char gname[32];
+        char devmajor[8];
+        char devminor[8];
+        char prefix[155];
+        char padding[12];
+} TarHeader;
+
+G_STATIC_ASSERT (sizeof (TarHeader) == TAR_BLOCK_SIZE);
+
+static guint
+tar_header_checksum (const TarHeader *header)
+{
+        const guchar *p = (const guchar *) header;
+        guint         sum = 0;
+        gsize         i;
+
+        for (i = 0; i < sizeof (TarHeader); i++) {
+                if (i >= (gsize) G_STRUCT_OFFSET (TarHeader, checksum) &&
+                    i < (gsize) G_STRUCT_OFFSET (TarHeader, checksum) + sizeof (header->checksum))
+                        sum += ' ';
+                else
+                        sum += p[i];
+        }
+        return sum;
+}
+
+static gboolean
+write_tar_padding (GOutputStream *stream, goffset size, GError **error)
+{
+        static const char zeros[TAR_BLOCK_SIZE] = { 0 };
+        gsize             pad;
+
+        pad = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+        if (pad == 0)
+                return TRUE;
+
+        return g_output_stream_write_all (stream, zeros, pad, NULL, NULL, error);
+}
+
+static gboolean
+export_one_file (GOutputStream *stream,
+                 GFile         *file,
+                 const char    *name,
+                 GError       **error)
+{
+        GFileInfo        *info;
+        GFileInputStream *input;
+        TarHeader         header;
+        goffset           size;
+        gssize            written;
+        gsize             length;
+
+        /* The name field is not necessarily terminated, but a longer
+         * name would be cut and imported as a different file */
+        length = strlen (name);
+        if (length > sizeof (header.name)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FILENAME_TOO_LONG,
+                             "The name '%s' is too long to be exported", name);
+                return FALSE;
+        }
+
+        /* Symbolic links are followed, the archive has to carry the
+         * sound files themselves to be of use on another system */
+        info = g_file_query_info (file,
+                                  G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                  G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                  G_FILE_QUERY_INFO_NONE,
+                                  NULL, error);
+        if (info == NULL)
+                return FALSE;
+
+        if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR) {
+                g_object_unref (info);
+                return TRUE;
+        }
+        size = g_file_info_get_size (info);
+        g_object_unref (info);
+
+        input = g_file_read (file, NULL, error);
+        if (input == NULL)
+                return FALSE;
+
+        memset (&header, 0, sizeof (header));
+        memcpy (header.name, name, length);
+        g_snprintf (header.mode, sizeof (header.mode), "%07o", 0644U);
+        g_snprintf (header.uid, sizeof (header.uid), "%07o", 0U);
+        g_snprintf (header.gid, sizeof (header.gid), "%07o", 0U);
+        g_snprintf (header.size, sizeof (header.size), "%011" G_GINT64_MODIFIER "o", (guint64) size);
+        g_snprintf (header.mtime, sizeof (header.mtime), "%011" G_GINT64_MODIFIER "o",
+                    (guint64) (g_get_real_time () / G_USEC_PER_SEC));
+        header.typeflag = '0';
+        memcpy (header.magic, "ustar", 6);
+        memcpy (header.version, "00", 2);
+        g_snprintf (header.checksum, sizeof (header.checksum), "%06o", tar_header_checksum (&header));
+        header.checksum[7] = ' ';
+
+        if (g_output_stream_write_all (stream, &header, sizeof (header), NULL, NULL, error) == FALSE) {
+                g_object_unref (input);
+                return FALSE;
+        }
+
+        written = g_output_stream_splice (stream,
+                                          G_INPUT_STREAM (input),
+                                          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE,
+                                          NULL, error);
+        g_object_unref (input);
+        if (written < 0)
+                return FALSE;
+
+        if (written != size) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "'%s' changed while being exported", name);
+                return FALSE;
+        }
+
+        return write_tar_padding (stream, size, error);
+}
+
+/**
+ * custom_theme_export :
+ * @stream : the stream to write the archive to
+ * @error  :
+ *
+ * Writes the custom theme, with the sound files it links to, to a
+ * single archive. index.theme always comes first.
+ **/
+gboolean
+custom_theme_export (GOutputStream *stream, GError **error)
+{
+        static const char zeros[TAR_BLOCK_SIZE * 2] = { 0 };
+        GDir             *d;
+        const char       *name;
+        char             *dir;
+        char             *path;
+        GFile            *file;
+        gboolean          success;
+
+        dir = custom_theme_dir_path (NULL);
+
+        path = g_build_filename (dir, "index.theme", NULL);
+        file = g_file_new_for_path (path);
+        g_free (path);
+        success = export_one_file (stream, file, "index.theme", error);
+        g_object_unref (file);
+
+        d = success ? g_dir_open (dir, 0, error) : NULL;
+        if (d == NULL) {
+                g_free (dir);
+                return FALSE;
+        }
+
+        while (success && (name = g_dir_read_name (d)) != NULL) {
+                if (strcmp (name, "index.theme") == 0)
+                        continue;
+
+                path = g_build_filename (dir, name, NULL);
+                file = g_file_new_for_path (path);
+                g_free (path);
+                success = export_one_file (stream, file, name, error);
+                g_object_unref (file);
+        }
+        g_dir_close (d);
+        g_free (dir);
+
+        /* End of archive marker */
+        if (success)
+                success = g_output_stream_write_all (stream, zeros, sizeof (zeros), NULL, NULL, error);
+
+        return success;
+}
+
+static gboolean
+import_is_valid_name (const char *name)
+{
+        return *name != '\0' && *name != '.' && strchr (name, '/') == NULL;
+}
+
+static gboolean
+import_one_file (GInputStream *stream,
+                 const char   *dir,
+                 const char   *name,
+                 goffset       size,
+                 GError      **error)
+{
+        GFile             *file;
+        GFileOutputStream *output;
+        char              *path;
+        char               buffer[8192];
+        goffset            remaining = size;
+        gboolean           success = TRUE;
+
+        path = g_build_filename (dir, name, NULL);
+        file = g_file_new_for_path (path);
+        g_free (path);
+
+        output = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+        g_object_unref (file);
+        if (output == NULL)
+                return FALSE;
+
+        while (success && remaining > 0) {
+                gsize count = MIN ((goffset) sizeof (buffer), remaining);
+                gsize bytes_read;
+
+                success = g_input_stream_read_all (stream, buffer, count, &bytes_read, NULL, error);
+                if (success && bytes_read != count) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                                     "Truncated archive");
+                        success = FALSE;
+                }
+                if (success)
+                        success = g_output_stream_write_all (G_OUTPUT_STREAM (output),
+                                                             buffer, count,
+                                                             NULL, NULL, error);
+                remaining -= count;
+        }
+
+        if (success)
+                success = g_output_stream_close (G_OUTPUT_STREAM (output), NULL, error);
+        g_object_unref (output);
+
+        return success;
+}
+
+/* Unpacks a member of the archive. The sound files go to the hidden
+ * directory of the theme and are linked from the theme like the alerts
+ * picked in the chooser, which only recognizes links as custom sounds */
+static gboolean
+import_sound (GInputStream *stream,
+              const char   *dir,
+              const char   *name,
+              goffset       size,
+              GError      **error)
+{
+        GFile    *file;
+        char     *imported_dir;
+        char     *path;
+        char     *target;
+        char     *child;
+        gboolean  success;
+
+        if (strcmp (name, "index.theme") == 0 || g_str_has_suffix (name, ".disabled"))
+                return import_one_file (stream, dir, name, size, error);
+
+        imported_dir = g_build_filename (dir, IMPORTED_SOUNDS_DIR, NULL);
+        if (g_mkdir_with_parents (imported_dir, 0755) != 0) {
+                int saved_errno = errno;
+
+                g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                             "Failed to create directory '%s': %s",
+                             imported_dir, g_strerror (saved_errno));
+                g_free (imported_dir);
+                return FALSE;
+        }
+
+        success = import_one_file (stream, imported_dir, name, size, error);
+        g_free (imported_dir);
+        if (success == FALSE)
+                return FALSE;
+
+        /* Link to where the file will be once the theme is published */
+        child = g_build_filename (IMPORTED_SOUNDS_DIR, name, NULL);
+        target = custom_theme_dir_path (child);
+        g_free (child);
+
+        path = g_build_filename (dir, name, NULL);
+        file = g_file_new_for_path (path);
+        g_free (path);
+
+        success = g_file_make_symbolic_link (file, target, NULL, error);
+        g_object_unref (file);
+        g_free (target);
+
+        return success;
+}
+
+/**
+ * custom_theme_import :
+ * @stream : the stream to read an archive written by custom_theme_export() from
+ * @error  :
+ *
+ * Replaces the custom theme with the content of the archive, read in a
+ * single pass. The theme is only replaced once the whole archive was
+ * unpacked successfully.
+ **/
+gboolean
+custom_theme_import (GInputStream *stream, GError **error)
+{
+        CustomThemeTransaction *transaction;
+        gboolean                success = TRUE;
+        gboolean                has_index = FALSE;
+        guint64                 total_size = 0;
+
+        transaction = custom_theme_transaction_new (FALSE);
+        if (transaction == NULL) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "Unable to create a staging directory");
+                return FALSE;
+        }
+
+        while (success) {
+                TarHeader header;
+                gsize     bytes_read;
+                char      name[sizeof (header.name) + 1];
+                char      size_str[sizeof (header.size) + 1];
+                guint64   size;
+                guint     checksum;
+
+                success = g_input_stream_read_all (stream, &header, sizeof (header),
+                                                   &bytes_read, NULL, error);
+                if (!success)
+                        break;
+                if (bytes_read != sizeof (header)) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                                     "Truncated archive");
+                        success = FALSE;
+                        break;
+                }
+
+                /* A zero block marks the end of the archive */
+                if (header.name[0] == '\0')
+                        break;
+
+                checksum = (guint) g_ascii_strtoull (header.checksum, NULL, 8);
+                if (checksum != tar_header_checksum (&header)) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                     "Invalid archive header");
+                        success = FALSE;
+                        break;
+                }
+
+                g_strlcpy (name, header.name, sizeof (name));
+                g_strlcpy (size_str, header.size, sizeof (size_str));
+                size = g_ascii_strtoull (size_str, NULL, 8);
+
+                if (!import_is_valid_name (name) ||
+                    (header.typeflag != '0' && header.typeflag != '\0')) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                     "Unexpected archive member '%s'", name);
+                        success = FALSE;
+                        break;
+                }
+
+                if (size > IMPORT_MAX_FILE_SIZE ||
+                    size > IMPORT_MAX_TOTAL_SIZE - total_size) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                     "The archive member '%s' is too large", name);
+                        success = FALSE;
+                        break;
+                }
+                total_size += size;
+
+                if (!has_index && strcmp (name, "index.theme") != 0) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                     "The archive does not start with index.theme");
+                        success = FALSE;
+                        break;
+                }
+                has_index = TRUE;
+
+                success = import_sound (stream, transaction->staging_dir, name, size, error);
+                if (success) {
+                        gsize pad = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+
+                        success = g_input_stream_read_all (stream, &header, pad,
+                                                           &bytes_read, NULL, error);
+                        if (success && bytes_read != pad) {
+                                g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                                             "Truncated archive");
+                                success = FALSE;
+                        }
+                }
+        }
+
+        if (success && !has_index) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             "Empty archive");
+                success = FALSE;
+        }
+
+        /* Publish everything at once, this also updates the theme time */
+        if (success)
+                success = custom_theme_transaction_commit (transaction, error);
+
+        custom_theme_transaction_free (transaction);
+
+        return success;
 }
@@ -22,17 +22,39 @@
 
 #include <gio/gio.h>
 
+typedef struct _CustomThemeTransaction CustomThemeTransaction;
+
 char *custom_theme_dir_path (const char *child);
 gboolean custom_theme_dir_is_empty (void);
-void create_custom_theme (const char *parent);
 
 void delete_custom_theme_dir (void);
-void delete_old_files (const char **sounds);
-void delete_disabled_files (const char **sounds);
-
-void add_disabled_file (const char **sounds);
-void add_custom_file (const char **sounds, const char *filename);
 
 void custom_theme_update_time (void);
 
+CustomThemeTransaction *custom_theme_transaction_begin (const char *parent);
+gboolean custom_theme_transaction_is_empty (CustomThemeTransaction *transaction);
+
+void custom_theme_transaction_delete_old_files (CustomThemeTransaction *transaction,
+                                                const char            **sounds);
+void custom_theme_transaction_delete_disabled_files (CustomThemeTransaction *transaction,
+                                                     const char            **sounds);
+
+void custom_theme_transaction_add_disabled_file (CustomThemeTransaction *transaction,
+                                                 const char            **sounds);
+void custom_theme_transaction_add_custom_file (CustomThemeTransaction *transaction,
+                                               const char            **sounds,
+                                               const char             *filename);
+
+gboolean custom_theme_transaction_commit (CustomThemeTransaction *transaction,
+                                          GError                **error);
+void custom_theme_transaction_free (CustomThemeTransaction *transaction);
+
+gboolean custom_theme_export (GOutputStream *stream, GError **error);
+gboolean custom_theme_import (GInputStream *stream, GError **error);
+
+gboolean sound_file_probe_header (const char *filename,
+                                  guint      *channels,
+                                  guint      *rate,
+                                  guint64    *duration_ms);
+
 #endif /* __SOUND_THEME_FILE_UTILS_HH__ */
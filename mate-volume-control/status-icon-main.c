@@ -32,6 +32,7 @@
 #include <libmatemixer/matemixer.h>
 
 #include "gvc-status-icon.h"
+#include "gvc-trace.h"
 
 static gboolean show_version = FALSE;
 static gboolean debug = FALSE;
@@ -48,6 +49,8 @@ main (int argc, char **argv)
                 { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
         };
 
+        gvc_trace_init ();
+
         bindtextdomain (GETTEXT_PACKAGE, LOCALE_DIR);
         bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
         textdomain (GETTEXT_PACKAGE);